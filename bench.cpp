@@ -0,0 +1,438 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "player.h"
+#include "corpus.h"
+#include "mcts.h"
+#include "trace.h"
+using namespace std;
+
+/*
+ * Benchmarks and batch tools for the engine.
+ *
+ *   bench startup [engine] [runs] [options...]
+ *       Launches the engine binary (default ./TVMA) 'runs' times, with the
+ *       given engine options, and reports the time until it prints "Init
+ *       done" and its resident set size at that point.
+ *
+ *   bench analyze [k] [ms]
+ *       Reads positions from stdin, one per line, as 64 characters ('b' for
+ *       black, 'w' for white, anything else for empty; row by row from the
+ *       top left) followed by the side to move, "Black" or "White". Prints
+ *       the best k moves (default 3) of each, searched for 'ms' milliseconds
+ *       (default 1000).
+ *
+ *   bench search [depth] [nodes] [trace] [--no-etc] [--no-stability]
+ *       Searches a fixed corpus of game positions to 'depth' plies (default
+ *       7; 0 for none) and/or for at most 'nodes' nodes each, and prints the
+ *       node counts, the speed and a signature of the results. Every limit is
+ *       counted in nodes or plies, never time, so the node counts and
+ *       signature are the same on every run; a change to them means the
+ *       search changed. With 'trace', records the search trees to that file
+ *       for treeprof. The last two options turn off the enhanced
+ *       transposition and the stability cutoffs.
+ *
+ *   bench pruning [depths...]
+ *       Searches the same positions with each combination of the two
+ *       cutoffs above on and off, to each depth (default 7 and 9), and
+ *       compares the node counts. Fails if the stability cutoff changes
+ *       the move chosen in any position, or the score of any move in a set
+ *       of endgames that can finish 32-32.
+ *
+ *   bench playouts [threads] [ms]
+ *       Measures the Monte Carlo search on the corpus positions: first the
+ *       raw random playouts per second on one core, then the playouts per
+ *       second of the whole tree search on 'threads' threads (default 1),
+ *       each for 'ms' milliseconds (default 2000).
+ */
+
+void usage(const char *name) {
+    cerr << "usage: " << name << " startup [engine] [runs] [options...]\n"
+         << "       " << name << " analyze [k] [ms] < positions\n"
+         << "       " << name << " search [depth] [nodes] [trace] [--no-etc] [--no-stability]\n"
+         << "       " << name << " pruning [depths...]\n"
+         << "       " << name << " playouts [threads] [ms]" << endl;
+    exit(-1);
+}
+
+/*
+ * Reads a "Name:   1234 kB" field out of /proc/<pid>/status.
+ */
+long procStatusKb(pid_t pid, const char *field) {
+    ifstream status("/proc/" + to_string(pid) + "/status");
+    string line;
+    size_t length = strlen(field);
+    while (getline(status, line)) {
+        if (line.compare(0, length, field) == 0 && line[length] == ':')
+            return atol(line.c_str() + length + 1);
+    }
+    return -1;
+}
+
+/*
+ * Starts the engine once and measures it up to "Init done". Returns false if
+ * the engine could not be started.
+ */
+bool measureStartup(const char *engine, vector<char *> &options, double &ms, long &rssKb) {
+    int out[2];
+    if (pipe(out) < 0)
+        return false;
+
+    auto start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(out[0]);
+        close(out[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(out[1]);
+        vector<char *> args = { (char *) engine, (char *) "Black" };
+        args.insert(args.end(), options.begin(), options.end());
+        args.push_back(nullptr);
+        execv(engine, args.data());
+        _exit(127);
+    }
+
+    close(out[1]);
+    string line;
+    char c;
+    while (read(out[0], &c, 1) == 1 && c != '\n')
+        line += c;
+    ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    rssKb = procStatusKb(pid, "VmRSS");
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    close(out[0]);
+    return line == "Init done";
+}
+
+int benchStartup(int argc, char *argv[]) {
+    const char *engine = (argc > 0 ? argv[0] : "./TVMA");
+    int runs = (argc > 1 ? atoi(argv[1]) : 10);
+    vector<char *> options(argv + min(argc, 2), argv + argc);
+    // atoi() reads anything that is not a number as 0.
+    if (runs < 1) {
+        cerr << "the number of runs must be at least 1" << endl;
+        return -1;
+    }
+
+    vector<double> times;
+    vector<long> rss;
+    for (int i = 0; i < runs; i++) {
+        double ms;
+        long kb;
+        if (!measureStartup(engine, options, ms, kb)) {
+            cerr << "could not start " << engine << endl;
+            return 1;
+        }
+        times.push_back(ms);
+        rss.push_back(kb);
+    }
+
+    sort(times.begin(), times.end());
+    sort(rss.begin(), rss.end());
+    cout << engine << ": " << runs << " runs\n"
+         << "  startup ms: min " << times.front() << ", median " << times[runs / 2]
+         << ", max " << times.back() << "\n"
+         << "  RSS at init: median " << rss[runs / 2] << " kB\n";
+    return 0;
+}
+
+/*
+ * Parses one line of a position file into a board and the side to move.
+ */
+bool readPosition(istream &in, Board &board, Side &side) {
+    string squares, toMove;
+    if (!(in >> squares >> toMove) || squares.size() != 64)
+        return false;
+
+    board.setBoard(&squares[0]);
+    side = (toMove == "Black" ? BLACK : WHITE);
+    return true;
+}
+
+int benchAnalyze(int argc, char *argv[]) {
+    int k = (argc > 0 ? atoi(argv[0]) : 3);
+    int ms = (argc > 1 ? atoi(argv[1]) : 1000);
+    if (k < 1) {
+        cerr << "the number of moves must be at least 1" << endl;
+        return -1;
+    }
+
+    for (int n = 1; ; n++) {
+        // A fresh board for every position, so that nothing found in one
+        // (such as its stable discs) carries over into the next.
+        Board board;
+        Side side;
+        if (!readPosition(cin, board, side))
+            break;
+
+        Player player(side);
+        *player.board = board;
+        player.elapsed_moves = board.countBlack() + board.countWhite() - 4;
+        player.setDuration(ms);
+
+        cout << "position " << n << ":\n";
+        int rank = 1;
+        for (RankedMove &line : player.getBestMoves(k)) {
+            cout << "  " << rank++ << ". (" << (int) line.move.x << ", " << (int) line.move.y << ") "
+                 << (line.exact ? "= " : "<= ") << line.score << "\n";
+        }
+    }
+    return 0;
+}
+
+struct SearchRun {
+    uint64_t nodes, etcCutoffs, stabilityCutoffs, signature;
+    double ms;
+    vector<Move> moves;
+};
+
+/*
+ * Searches every fourth corpus position from an empty transposition table.
+ */
+SearchRun searchCorpus(vector<BenchPosition> &corpus, int depth, uint64_t nodeLimit,
+                       bool etc, bool stability, bool verbose) {
+    SearchRun run = { 0, 0, 0, 14695981039346656037ull, 0, {} };
+    clearHashTables();
+
+    for (size_t i = 0; i < corpus.size(); i += 4) {
+        BenchPosition &position = corpus[i];
+        Player player(position.side);
+        *player.board = position.board;
+        player.elapsed_moves = position.elapsedMoves;
+        player.setSearchLimits(nodeLimit, depth);
+        player.useETC = etc;
+        player.useStabilityCutoff = stability;
+
+        auto start = chrono::steady_clock::now();
+        Move move = player.getBestMove();
+        run.ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        if (verbose) {
+            cout << "position " << i << ": (" << (int) move.x << ", " << (int) move.y << ") "
+                 << player.nodes << " nodes\n";
+        }
+
+        run.moves.push_back(move);
+        run.nodes += player.nodes;
+        run.etcCutoffs += player.etcCutoffs;
+        run.stabilityCutoffs += player.stabilityCutoffs;
+        for (uint64_t value : { player.nodes, (uint64_t) move.x, (uint64_t) move.y })
+            run.signature = (run.signature ^ value) * 1099511628211ull;
+    }
+    return run;
+}
+
+int benchSearch(int argc, char *argv[]) {
+    bool etc = true, stability = true;
+    vector<char *> args;
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "--no-etc"))
+            etc = false;
+        else if (!strcmp(argv[i], "--no-stability"))
+            stability = false;
+        else
+            args.push_back(argv[i]);
+    }
+    int depth = (args.size() > 0 ? atoi(args[0]) : 7);
+    uint64_t nodeLimit = (args.size() > 1 ? strtoull(args[1], nullptr, 10) : 0);
+
+    vector<BenchPosition> corpus = gamePositions();
+    if (args.size() > 2 && !startTrace(args[2])) {
+        cerr << "cannot write " << args[2] << endl;
+        return 1;
+    }
+
+    SearchRun run = searchCorpus(corpus, depth, nodeLimit, etc, stability, true);
+    stopTrace();
+
+    cout << "Total nodes: " << run.nodes << "\n"
+         << "ETC cutoffs: " << run.etcCutoffs << "\n"
+         << "Stability cutoffs: " << run.stabilityCutoffs << "\n"
+         << "Time ms: " << run.ms << "\n"
+         << "Nodes/second: " << (uint64_t) (run.nodes / (run.ms / 1000)) << "\n"
+         << "Signature: " << hex << run.signature << dec << endl;
+    return 0;
+}
+
+/*
+ * Endgames, one with each side to move, where some lines finish 32-32 with
+ * one side holding 32 stable discs. Board::score() counts a draw as a loss
+ * for the side to move at the end, so those discs alone do not decide the
+ * result.
+ */
+const char *drawEndgames[] = {
+    "b.bbbbbbbbwwwbb.bwbbwbbwbwbwbbbwbwwwwwbbbwwwwwb.bbwwwwbbwb.wbbb. White",
+    ".wwwwwwwbwwbbbbbbwbwbbbbbbbwbbwbb.wbwwwbbwbbwwbbwwwwwwwbb..bbbbb Black"
+};
+
+/*
+ * Searches every move of the endgames above to the end of the game with
+ * and without the stability cutoff. Returns the number of move scores that
+ * differ.
+ */
+int checkDrawEndgames() {
+    int changed = 0;
+    for (const char *endgame : drawEndgames) {
+        vector<RankedMove> results[2];
+        for (int stability = 0; stability < 2; stability++) {
+            istringstream in(endgame);
+            Board board;
+            Side side;
+            readPosition(in, board, side);
+
+            clearHashTables();
+            Player player(side);
+            *player.board = board;
+            player.elapsed_moves = board.countBlack() + board.countWhite() - 4;
+            player.setSearchLimits(0, 2 * (64 - board.countBlack() - board.countWhite()) + 1);
+            player.useStabilityCutoff = stability;
+            results[stability] = player.getBestMoves(64);
+            sort(results[stability].begin(), results[stability].end(),
+                 [](const RankedMove& a, const RankedMove& b) {
+                return 8 * a.move.y + a.move.x < 8 * b.move.y + b.move.x;
+            });
+        }
+
+        for (size_t i = 0; i < results[0].size(); i++)
+            changed += (results[0][i].score != results[1][i].score);
+    }
+    return changed;
+}
+
+int benchPruning(int argc, char *argv[]) {
+    vector<int> depths;
+    for (int i = 0; i < argc; i++)
+        depths.push_back(atoi(argv[i]));
+    if (depths.empty())
+        depths = { 7, 9 };
+
+    vector<BenchPosition> corpus = gamePositions();
+    cout << "# depth\tETC\tstability\tnodes\tsaved\tETC cutoffs\tstability cutoffs\tms\tmoves changed"
+         << endl;
+    int changed = 0;
+    for (int depth : depths) {
+        SearchRun runs[4];
+        for (int config = 0; config < 4; config++) {
+            bool etc = config & 1, stability = config & 2;
+            SearchRun &run = runs[config] = searchCorpus(corpus, depth, 0, etc, stability, false);
+            uint64_t baseline = runs[0].nodes;
+
+            cout << depth << "\t" << (etc ? "on" : "off") << "\t" << (stability ? "on" : "off") << "\t"
+                 << run.nodes << "\t" << fixed << setprecision(1)
+                 << 100.0 * ((double) baseline - run.nodes) / baseline << "%"
+                 << defaultfloat << setprecision(6) << "\t" << run.etcCutoffs << "\t"
+                 << run.stabilityCutoffs << "\t" << run.ms << "\t";
+
+            // The stability cutoff only returns what the full search would
+            // have found, so it must not change any move: compare with the
+            // same run without it.
+            if (stability) {
+                const SearchRun &without = runs[config & ~2];
+                int moves = 0;
+                for (size_t i = 0; i < run.moves.size(); i++)
+                    moves += (run.moves[i].x != without.moves[i].x ||
+                              run.moves[i].y != without.moves[i].y);
+                cout << moves;
+                changed += moves;
+            } else {
+                cout << "-";
+            }
+            cout << endl;
+        }
+    }
+
+    int endgameScores = checkDrawEndgames();
+    cout << "# 32-32 endgames: " << endgameScores << " move scores changed by the stability cutoff"
+         << endl;
+
+    if (changed || endgameScores) {
+        cerr << changed << " moves and " << endgameScores
+             << " endgame scores changed by the stability cutoff" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int benchPlayouts(int argc, char *argv[]) {
+    int threads = (argc > 0 ? atoi(argv[0]) : 1);
+    int ms = (argc > 1 ? atoi(argv[1]) : 2000);
+    // atoi() reads anything that is not a number as 0.
+    if (threads < 1 || ms < 1) {
+        cerr << "the threads and milliseconds must be at least 1" << endl;
+        return -1;
+    }
+
+    vector<BenchPosition> corpus = gamePositions();
+    uint64_t rng = 2014;
+    uint64_t playouts = 0;
+    long sum = 0;
+
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    while (elapsed < ms) {
+        for (BenchPosition &p : corpus) {
+            uint64_t own = (p.side == BLACK ? p.board.black : p.board.white);
+            uint64_t other = (p.side == BLACK ? p.board.white : p.board.black);
+            sum += randomPlayout(own, other, rng);
+        }
+        playouts += corpus.size();
+        elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+    cout << "Random playouts/second: " << (uint64_t) (playouts / (elapsed / 1000))
+         << " (mean result " << (double) sum / playouts << ")\n";
+
+    // The tree search, on every 16th position for an equal share of the time.
+    MCTS mcts;
+    playouts = 0;
+    elapsed = 0;
+    size_t searched = (corpus.size() + 15) / 16;
+    for (size_t i = 0; i < corpus.size(); i += 16) {
+        BenchPosition &position = corpus[i];
+        start = chrono::steady_clock::now();
+        mcts.search(position.board, position.side, threads,
+                    currentTimeMillis() + ms / searched, 0);
+        elapsed += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        playouts += mcts.playouts;
+    }
+    uint64_t rate = (uint64_t) (playouts / (elapsed / 1000));
+    cout << "MCTS playouts/second on " << threads << " threads: " << rate
+         << " (" << rate / threads << " per thread)" << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        usage(argv[0]);
+
+    string command = argv[1];
+    if (command == "startup")
+        return benchStartup(argc - 2, argv + 2);
+    if (command == "search")
+        return benchSearch(argc - 2, argv + 2);
+    if (command == "analyze")
+        return benchAnalyze(argc - 2, argv + 2);
+    if (command == "pruning")
+        return benchPruning(argc - 2, argv + 2);
+    if (command == "playouts")
+        return benchPlayouts(argc - 2, argv + 2);
+
+    usage(argv[0]);
+    return -1;
+}
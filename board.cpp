@@ -1,7 +1,10 @@
 #include "board.h"
 #include "constants.h"
+#include "symmetry.h"
 
-#define COMBINE(a, b) ((a + b) == 0 ? (0.0) : (100*(a-b)*1.0/(a+b)))
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 /*
  * Generates possible moves for pieces of the bitboard 'own' in the direction
@@ -24,8 +27,9 @@ inline uint64_t generateMove(uint64_t(*shift)(uint64_t), uint64_t own, uint64_t
 
 #define IS_STABLE(pos) (!(pos) || ((pos) & stablePieces))
 
-inline uint64_t Board::generateStablePieces(Side side) {
-    uint64_t ourBoard = (side == WHITE ? white : black);
+template <Side S>
+uint64_t Board::generateStablePieces() {
+    uint64_t ourBoard = own<S>();
     if (!(ourBoard & all_corners)) //Stable pieces cannot exist w/o corners.
         return 0ull;
 
@@ -47,7 +51,7 @@ inline uint64_t Board::generateStablePieces(Side side) {
             locked_antidiag |= anti_diagonals[i];
     }
 
-    uint64_t stablePieces = (side == WHITE ? white_stables : black_stables);
+    uint64_t stablePieces = stablesOf<S>();
     stablePieces |= ourBoard & locked_rows & locked_columns & locked_diag & locked_antidiag;
     stablePieces |= (ourBoard & all_corners);
 
@@ -83,6 +87,10 @@ inline uint64_t Board::generateStablePieces(Side side) {
     return stablePieces;
 }
 
+uint64_t Board::generateStablePieces(Side side) {
+    return side == BLACK ? generateStablePieces<BLACK>() : generateStablePieces<WHITE>();
+}
+
 /*
  * Returns a copy of this board.
  */
@@ -90,46 +98,93 @@ Board *Board::copy() {
     return new Board(*this);
 }
 
-Board* Board::copyDoMove(Move* m, Side side) {
+template <Side S>
+Board* Board::copyDoMove(Move* m) {
     Board* newBoard = copy();
-    newBoard->doMove(m, side);
+    newBoard->doMove<S>(m);
     return newBoard;
 }
 
+Board* Board::copyDoMove(Move* m, Side side) {
+    return side == BLACK ? copyDoMove<BLACK>(m) : copyDoMove<WHITE>(m);
+}
+
 bool Board::occupied(int x, int y) {
-    return get(WHITE, x, y) || get(BLACK, x, y);
+    return get<WHITE>(x, y) || get<BLACK>(x, y);
 }
 
 bool Board::get(Side side, int x, int y) {
-    return (side == BLACK ? black : white) & getSinglePosition(x, y);
+    return side == BLACK ? get<BLACK>(x, y) : get<WHITE>(x, y);
 }
 
 void Board::set(Side side, int x, int y) {
-    (side == BLACK ? black : white) |= getSinglePosition(x, y);
+    if (side == BLACK)
+        set<BLACK>(x, y);
+    else
+        set<WHITE>(x, y);
+}
+
+/*
+ * The squares where 'own' can move against 'other'.
+ */
+uint64_t Board::mobility(uint64_t own, uint64_t other) {
+    return generateMove(NORTH, own, other)
+         | generateMove(SOUTH, own, other)
+         | generateMove(EAST, own, other)
+         | generateMove(WEST, own, other)
+         | generateMove(NOREAST, own, other)
+         | generateMove(SOUEAST, own, other)
+         | generateMove(NORWEST, own, other)
+         | generateMove(SOUWEST, own, other);
+}
+
+/*
+ * The discs of the line byte 'other' that 'own' turns over by playing at
+ * bit p of the line.
+ */
+inline uint64_t flipLine(int p, uint64_t own, uint64_t other) {
+    return lineFlips.v[p][lineOutflank.v[p][(other >> 1) & 0x3f] & own];
+}
+
+/*
+ * The discs of 'other' that 'own' turns over by playing on (x, y). Each of
+ * the four lines through the square is gathered into a byte, looked up in
+ * the flip tables and spread back out, with no data-dependent loops or
+ * branches.
+ * doDirection() is the square by square reference for it.
+ */
+uint64_t Board::flips(int x, int y, uint64_t own, uint64_t other) {
+    const uint64_t fileA = 0x0101010101010101ull;
+
+    // Row y is byte 7 - y of the board, with x at bit 7 - x.
+    int shift = 8 * (7 - y);
+    uint64_t result = flipLine(7 - x, (own >> shift) & 0xff, (other >> shift) & 0xff) << shift;
+
+    // Column x, gathered by a multiply with y at bit 7 - y; spreading it back
+    // copies the byte to every row, keeps bit 7 - y in row y, and moves that
+    // bit to column x.
+    auto column = [x](uint64_t b) { return (((b >> (7 - x)) & fileA) * 0x0102040810204080ull) >> 56; };
+    uint64_t line = flipLine(7 - y, column(own), column(other));
+    result |= ((((line * fileA) & 0x8040201008040201ull) + 0x7f7f7f7f7f7f7f7full)
+               & 0x8080808080808080ull) >> x;
+
+    // The diagonals have at most one square per row, so a multiply ORs the
+    // rows together into a byte with x at bit 7 - x.
+    for (uint64_t mask : { diagonals[diagonalIndex(x, y)], anti_diagonals[antiDiagonalIndex(x, y)] }) {
+        line = flipLine(7 - x, ((own & mask) * fileA) >> 56, ((other & mask) * fileA) >> 56);
+        result |= (line * fileA) & mask;
+    }
+
+    return result;
 }
 
 void Board::generateMoves() {
     //Generate black moves first:
-    black_moves = generateMove(NORTH, black, white)
-                | generateMove(SOUTH, black, white)
-                | generateMove(EAST, black, white)
-                | generateMove(WEST, black, white)
-                | generateMove(NOREAST, black, white)
-                | generateMove(SOUEAST, black, white)
-                | generateMove(NORWEST, black, white)
-                | generateMove(SOUWEST, black, white);
-
-    white_moves = generateMove(NORTH, white, black)
-                | generateMove(SOUTH, white, black)
-                | generateMove(EAST, white, black)
-                | generateMove(WEST, white, black)
-                | generateMove(NOREAST, white, black)
-                | generateMove(SOUEAST, white, black)
-                | generateMove(NORWEST, white, black)
-                | generateMove(SOUWEST, white, black);
-
-    black_stables = generateStablePieces(BLACK);
-    white_stables = generateStablePieces(WHITE);
+    black_moves = mobility(black, white);
+    white_moves = mobility(white, black);
+
+    black_stables = generateStablePieces<BLACK>();
+    white_stables = generateStablePieces<WHITE>();
 }
 
 /*
@@ -137,29 +192,30 @@ void Board::generateMoves() {
  * if neither side has a legal move.
  */
 bool Board::isDone() {
-    return !(hasMoves(BLACK) || hasMoves(WHITE));
+    return !(black_moves | white_moves);
 }
 
 /*
  * Returns true if there are legal moves for the given side.
  */
 bool Board::hasMoves(Side side) {
-    return (side == BLACK ? black_moves : white_moves) != 0;
+    return side == BLACK ? hasMoves<BLACK>() : hasMoves<WHITE>();
 }
 
 /*
  * Returns true if a move is legal for the given side; false otherwise.
  */
 bool Board::checkMove(Move *m, Side side) {
-    return (getSinglePosition(m->getX(), m->getY()) & (side == BLACK ? black_moves : white_moves)) != 0;
+    return side == BLACK ? checkMove<BLACK>(m) : checkMove<WHITE>(m);
 }
 
 /* Carries out a move in a specific direction */
-uint64_t Board::doDirection(int x, int y, Side side, uint64_t(*shift)(uint64_t)) {
+template <Side S>
+uint64_t Board::doDirection(int x, int y, uint64_t(*shift)(uint64_t)) {
     uint64_t m = getSinglePosition(x, y);
     uint64_t changed = m;
-    uint64_t ourBoard = (side == BLACK ? black : white);
-    uint64_t otherBoard = (side == BLACK ? white : black);
+    uint64_t ourBoard = own<S>();
+    uint64_t otherBoard = other<S>();
 
     //Keep shifting 'm' until we are no longer over a white piece
     //tracking the change on "changed".
@@ -175,62 +231,66 @@ uint64_t Board::doDirection(int x, int y, Side side, uint64_t(*shift)(uint64_t))
     return 0;
 }
 
+uint64_t Board::doDirection(int x, int y, Side side, uint64_t(*shift)(uint64_t)) {
+    return side == BLACK ? doDirection<BLACK>(x, y, shift) : doDirection<WHITE>(x, y, shift);
+}
+
 /*
  * Returns a vector of possible legal moves for the current board state.
  */
-vector<Move> Board::getMoves(Side side)
+template <Side S>
+vector<Move> Board::getMoves()
 {
+    // Transposed, so that reading the set bits from the top down lists the
+    // moves in x-major order, the order a scan over the squares gives.
+    uint64_t moves = flipDiagonal(movesOf<S>());
+
     vector<Move> moves_list;
-    for (int x = 0; x < 8; x++)
-    {
-        for (int y = 0; y < 8; y++)
-        {
-            Move move(x,y);
-            if (checkMove(&move, side))
-                moves_list.push_back(move);
-        }
+    moves_list.reserve(popcount(moves));
+    while (moves) {
+        int i = __builtin_clzll(moves);
+        moves_list.push_back(Move(i / 8, i % 8));
+        moves ^= 0x8000000000000000ull >> i;
     }
     return moves_list;
 }
 
+vector<Move> Board::getMoves(Side side) {
+    return side == BLACK ? getMoves<BLACK>() : getMoves<WHITE>();
+}
+
 /*
  * Modifies the board to reflect the specified move.
  */
-bool Board::doMove(Move* m, Side side) {
+template <Side S>
+bool Board::doMove(Move* m) {
     // Passing is only legal if you have no moves.
-    if (m == nullptr) return !hasMoves(side);
+    if (m == nullptr) return !hasMoves<S>();
 
     int x = m->getX();
     int y = m->getY();
 
     // Make sure the move is correct.
-    if (!checkMove(m, side))
+    if (!checkMove<S>(m))
         return false;
 
-    //newBoard is essentially the bitmap of pieces which have changed hands.
-    uint64_t newBoard = doDirection(x, y, side, NORTH);
-    newBoard |= doDirection(x, y, side, SOUTH);
-    newBoard |= doDirection(x, y, side, EAST);
-    newBoard |= doDirection(x, y, side, WEST);
-    newBoard |= doDirection(x, y, side, NOREAST);
-    newBoard |= doDirection(x, y, side, NORWEST);
-    newBoard |= doDirection(x, y, side, SOUEAST);
-    newBoard |= doDirection(x, y, side, SOUWEST);
-
-    if (newBoard == 0)
+    uint64_t flipped = flips(x, y, own<S>(), other<S>());
+    if (flipped == 0)
         return false;
 
-    //We apply it to the board that receives the new pieces
-    (side == BLACK ? black : white) |= newBoard;
-    //And then we can do a sanity check and "un-apply" them from the other.
-    (side == BLACK ? white : black) &= ~(side == BLACK ? black : white);
+    own<S>() |= flipped;
+    other<S>() &= ~flipped;
 
-    set(side, x, y);
+    set<S>(x, y);
     generateMoves();
 
     return true;
 }
 
+bool Board::doMove(Move* m, Side side) {
+    return side == BLACK ? doMove<BLACK>(m) : doMove<WHITE>(m);
+}
+
 /*
  * Current count of given side's stones.
  */
@@ -242,90 +302,201 @@ int Board::count(Side side) {
  * Current count of black stones.
  */
 int Board::countBlack() {
-    uint64_t board = black;
-
-    int count = 0;
-    while (board) {
-        count += (board & 1);
-        board >>= 1;
-    }
-
-    return count;
+    return popcount(black);
 }
 
 /*
  * Current count of white stones.
  */
 int Board::countWhite() {
-    uint64_t board = white;
+    return popcount(white);
+}
 
-    int count = 0;
-    while (board) {
-        count += (board & 1);
-        board >>= 1;
-    }
+/*
+ * Combines the raw counts of each evaluation term into a score from white's
+ * point of view, using the fixed-point weights of the given game phase. All
+ * the weights are compile-time constants, so each phase is straight-line
+ * integer code.
+ */
+template <int Phase>
+inline int combineTerms(int whiteCoins, int blackCoins, int whiteMoves, int blackMoves,
+                        int utilityDiff, int whiteStables, int blackStables) {
+    typedef PhaseWeights<Phase> W;
+
+    int64_t coinParity = (whiteCoins - blackCoins) * parityReciprocal[whiteCoins + blackCoins];
+    int64_t moveParity = (whiteMoves - blackMoves) * parityReciprocal[whiteMoves + blackMoves];
+    int64_t stableParity = (whiteStables - blackStables) * parityReciprocal[whiteStables + blackStables];
+    int64_t utilityParity = utilityDiff * 10 * PARITY_ONE;
+
+    int64_t sum = utilityParity * W::utility + moveParity * W::mobility
+                + coinParity * W::coins + stableParity * W::stables;
+
+    return (int) (100 * sum / (W::total * PARITY_ONE));
+}
 
-    return count;
+/*
+ * Evaluates a position that is not finished, using the weights of the given
+ * game phase. Every term is a popcount over masked bitboards.
+ */
+template <int Phase, Side S>
+int Board::evaluate() {
+    int utilityDiff = 0;
+    for (int i = 0; i < NUM_UTILITY_WEIGHTS; i++)
+        utilityDiff += utilityWeights[i] * (popcount(white & utilityMasks[i]) - popcount(black & utilityMasks[i]));
+
+    int finalScore = combineTerms<Phase>(popcount(white), popcount(black),
+                                         popcount(white_moves), popcount(black_moves),
+                                         utilityDiff,
+                                         popcount(white & white_stables), popcount(black & black_stables));
+
+    return S == WHITE ? finalScore : -finalScore;
 }
 
 /*
  * Returns the strategic value of a board position.
  */
-int Board::score(Side side, int elapsedMoves)
+template <Side S>
+int Board::score(int elapsedMoves)
 {
     if (isDone()) {
-        if (count(side) > count(OPPOSITE(side))) {
+        if (count<S>() > count<OPPOSITE(S)>()) {
             return INT_MAX - 1;
         } else
             return -(INT_MAX - 1);
     }
 
-    //It is significantly easier to calculate the score as if it were always white
-    //and then simply flipping the score if we are instead calculating for black.
-    int whiteCoins = 0, blackCoins = 0;
-    int whiteMoves = 0, blackMoves = 0;
-    int whiteUtility = 0, blackUtility = 0;
-    int whiteStables = 0, blackStables = 0;
+    switch (gamePhase(elapsedMoves)) {
+    case 0: return evaluate<0, S>();
+    case 1: return evaluate<1, S>();
+    case 2: return evaluate<2, S>();
+    default: return evaluate<3, S>();
+    }
+}
 
-    for (int x = 0; x < 8; x++) {
-        for (int y = 0; y < 8; y++) {
-            uint64_t pos = getSinglePosition(x, y);
-            if (white & pos) {
-                whiteCoins++;
-                whiteUtility += utilityMatrix[x][y];
-                if (pos & white_stables)
-                    whiteStables++;
-            } else if (black & pos) {
-                blackCoins++;
-                blackUtility += utilityMatrix[x][y];
-                if (pos & black_stables)
-                    blackStables++;
-            } else {
-                if (white_moves & pos)
-                    whiteMoves++;
-                if (black_moves & pos) // NOT 'else', since they can both have it.
-                    blackMoves++;
-            }
+int Board::score(Side side, int elapsedMoves) {
+    return side == BLACK ? score<BLACK>(elapsedMoves) : score<WHITE>(elapsedMoves);
+}
+
+/*
+ * Appends a position to the batch.
+ */
+void BoardBatch::add(const Board &board) {
+    black[size] = board.black;
+    white[size] = board.white;
+    black_moves[size] = board.black_moves;
+    white_moves[size] = board.white_moves;
+    black_stables[size] = board.black_stables;
+    white_stables[size] = board.white_stables;
+    size++;
+}
+
+/*
+ * Finishes the evaluation of one position of a batch from its raw counts,
+ * the same way Board::score() does.
+ */
+template <int Phase, Side S>
+inline int finishBatchScore(const BoardBatch &batch, int i,
+                            int whiteCoins, int blackCoins, int whiteMoves, int blackMoves,
+                            int utilityDiff, int whiteStables, int blackStables) {
+    if (!(batch.black_moves[i] | batch.white_moves[i])) {
+        int ours = (S == WHITE ? whiteCoins : blackCoins);
+        int theirs = (S == WHITE ? blackCoins : whiteCoins);
+        return ours > theirs ? INT_MAX - 1 : -(INT_MAX - 1);
+    }
+
+    int finalScore = combineTerms<Phase>(whiteCoins, blackCoins, whiteMoves, blackMoves,
+                                         utilityDiff, whiteStables, blackStables);
+    return S == WHITE ? finalScore : -finalScore;
+}
+
+#ifdef __AVX2__
+/*
+ * Per-lane popcount of four bitboards. Uses the AVX-512 instruction when the
+ * target has it, and the nibble-lookup method otherwise.
+ */
+inline __m256i popcount4(__m256i v) {
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512VL__)
+    return _mm256_popcnt_epi64(v);
+#else
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, nibble));
+    __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+#endif
+}
+
+#define LOAD4(array, i) _mm256_load_si256((const __m256i *) ((array) + (i)))
+#endif
+
+/*
+ * Evaluates the positions of a batch for the given side, four at a time
+ * with AVX2 where available. Writes one score per position to 'scores',
+ * identical to what Board::score() returns for each of them.
+ */
+template <int Phase, Side S>
+void scoreBatchPhase(const BoardBatch &batch, int *scores) {
+    int i = 0;
+
+#ifdef __AVX2__
+    alignas(32) int64_t wc[4], bc[4], wm[4], bm[4], ws[4], bs[4], util[4];
+
+    for (; i + 4 <= batch.size; i += 4) {
+        __m256i w = LOAD4(batch.white, i), b = LOAD4(batch.black, i);
+
+        __m256i u = _mm256_setzero_si256();
+        for (int k = 0; k < NUM_UTILITY_WEIGHTS; k++) {
+            __m256i mask = _mm256_set1_epi64x(utilityMasks[k]);
+            __m256i diff = _mm256_sub_epi64(popcount4(_mm256_and_si256(w, mask)),
+                                            popcount4(_mm256_and_si256(b, mask)));
+            u = _mm256_add_epi64(u, _mm256_mul_epi32(diff, _mm256_set1_epi64x(utilityWeights[k])));
         }
+
+        _mm256_store_si256((__m256i *) wc, popcount4(w));
+        _mm256_store_si256((__m256i *) bc, popcount4(b));
+        _mm256_store_si256((__m256i *) wm, popcount4(LOAD4(batch.white_moves, i)));
+        _mm256_store_si256((__m256i *) bm, popcount4(LOAD4(batch.black_moves, i)));
+        _mm256_store_si256((__m256i *) ws, popcount4(_mm256_and_si256(w, LOAD4(batch.white_stables, i))));
+        _mm256_store_si256((__m256i *) bs, popcount4(_mm256_and_si256(b, LOAD4(batch.black_stables, i))));
+        _mm256_store_si256((__m256i *) util, u);
+
+        for (int j = 0; j < 4; j++)
+            scores[i + j] = finishBatchScore<Phase, S>(batch, i + j, wc[j], bc[j], wm[j], bm[j],
+                                                    util[j], ws[j], bs[j]);
     }
+#endif
+
+    for (; i < batch.size; i++) {
+        uint64_t w = batch.white[i], b = batch.black[i];
+
+        int utilityDiff = 0;
+        for (int k = 0; k < NUM_UTILITY_WEIGHTS; k++)
+            utilityDiff += utilityWeights[k] * (popcount(w & utilityMasks[k]) - popcount(b & utilityMasks[k]));
 
-    float coinParity = COMBINE(whiteCoins, blackCoins);
-    float moveParity = COMBINE(whiteMoves, blackMoves);
-    float utilityParity = (whiteUtility - blackUtility)*10;
-    float stableParity = COMBINE(whiteStables, blackStables);
-    float finalScore = 0;
-
-    if (elapsedMoves < 20) {
-        finalScore = 100 * (utilityParity * 0.55 + moveParity * 0.5 + coinParity * 0.05) / (0.55 + 0.5 + 0.05);
-    } else if (elapsedMoves < 30) {
-        finalScore = 100 * (utilityParity * 0.55 + moveParity * 0.5 - coinParity * 0.05 + stableParity * 0.3) / (1.3);
-    } else if (elapsedMoves < 40) {
-        finalScore = 100 * (utilityParity * 0.55 + moveParity * 0.5 - coinParity * 0.05 + stableParity * 0.4) / (1.4);
-    } else {
-        finalScore = 100 * (utilityParity * 0.4 + moveParity * 0.2 + coinParity * 0.15 + stableParity * 0.5) / (0.4 + 0.5 + 0.15 + 0.8);
+        scores[i] = finishBatchScore<Phase, S>(batch, i, popcount(w), popcount(b),
+                                            popcount(batch.white_moves[i]), popcount(batch.black_moves[i]),
+                                            utilityDiff,
+                                            popcount(w & batch.white_stables[i]),
+                                            popcount(b & batch.black_stables[i]));
     }
+}
 
-    return (int) (side == WHITE ? finalScore : -finalScore);
+template <Side S>
+void scoreBatch(const BoardBatch &batch, int elapsedMoves, int *scores) {
+    switch (gamePhase(elapsedMoves)) {
+    case 0: scoreBatchPhase<0, S>(batch, scores); break;
+    case 1: scoreBatchPhase<1, S>(batch, scores); break;
+    case 2: scoreBatchPhase<2, S>(batch, scores); break;
+    default: scoreBatchPhase<3, S>(batch, scores); break;
+    }
+}
+
+void scoreBatch(const BoardBatch &batch, Side side, int elapsedMoves, int *scores) {
+    if (side == BLACK)
+        scoreBatch<BLACK>(batch, elapsedMoves, scores);
+    else
+        scoreBatch<WHITE>(batch, elapsedMoves, scores);
 }
 
 void Board::printBoard() {
@@ -364,7 +535,10 @@ void Board::setBoard(char data[]) {
     white = 0;
     black_moves = 0;
     white_moves = 0;
-
+    // generateStablePieces() adds to the stable discs found so far, which
+    // belong to the position this board held before.
+    black_stables = 0;
+    white_stables = 0;
 
     for (int i = 0; i < 64; i++) {
         if (data[i] == 'b') {
@@ -376,3 +550,17 @@ void Board::setBoard(char data[]) {
 
     generateMoves();
 }
+
+// The search calls the side-specialised versions directly.
+template uint64_t Board::generateStablePieces<BLACK>();
+template uint64_t Board::generateStablePieces<WHITE>();
+template Board* Board::copyDoMove<BLACK>(Move* m);
+template Board* Board::copyDoMove<WHITE>(Move* m);
+template vector<Move> Board::getMoves<BLACK>();
+template vector<Move> Board::getMoves<WHITE>();
+template bool Board::doMove<BLACK>(Move* m);
+template bool Board::doMove<WHITE>(Move* m);
+template int Board::score<BLACK>(int elapsedMoves);
+template int Board::score<WHITE>(int elapsedMoves);
+template void scoreBatch<BLACK>(const BoardBatch &batch, int elapsedMoves, int *scores);
+template void scoreBatch<WHITE>(const BoardBatch &batch, int elapsedMoves, int *scores);
@@ -2,6 +2,7 @@
 #define __BOARD_H__
 
 #include "common.h"
+#include "constants.h"
 using namespace std;
 
 class Board {
@@ -10,16 +11,33 @@ public:
     uint64_t black_moves, white_moves;
     uint64_t black_stables, white_stables;
 
+    // The bitboards of the side to move, its opponent, its legal moves and
+    // its stable pieces, chosen at compile time.
+    template <Side S> uint64_t& own() { return S == BLACK ? black : white; }
+    template <Side S> uint64_t& other() { return S == BLACK ? white : black; }
+    template <Side S> uint64_t& movesOf() { return S == BLACK ? black_moves : white_moves; }
+    template <Side S> uint64_t& stablesOf() { return S == BLACK ? black_stables : white_stables; }
+
     bool occupied(int x, int y);
     bool get(Side side, int x, int y);
     void set(Side side, int x, int y);
     void generateMoves();
+    static uint64_t mobility(uint64_t own, uint64_t other);
+    static uint64_t flips(int x, int y, uint64_t own, uint64_t other);
     uint64_t doDirection(int x, int y, Side side, uint64_t(*shift)(uint64_t));
     uint64_t generateStablePieces(Side side);
 
+    template <Side S> bool get(int x, int y) { return own<S>() & getSinglePosition(x, y); }
+    template <Side S> void set(int x, int y) { own<S>() |= getSinglePosition(x, y); }
+    template <Side S> uint64_t doDirection(int x, int y, uint64_t(*shift)(uint64_t));
+    template <Side S> uint64_t generateStablePieces();
+    template <int Phase, Side S> int evaluate();
+
 public:
     // The board is initialized to the bitmaps that signify the starting positions.
-    Board() : black(34628173824), white(68853694464) { generateMoves(); };
+    Board() : black(34628173824), white(68853694464), black_stables(0), white_stables(0) {
+        generateMoves();
+    };
     Board(const Board&) = default;
     ~Board() = default;
     Board* copy();
@@ -37,6 +55,38 @@ public:
 
     void setBoard(char data[]);
     void printBoard();
+
+    // Versions of the above specialised on the side to move. The methods
+    // that take a Side just pick one of these.
+    template <Side S> Board* copyDoMove(Move* m);
+    template <Side S> bool hasMoves() { return movesOf<S>() != 0; }
+    template <Side S> bool checkMove(Move *m) {
+        return (getSinglePosition(m->getX(), m->getY()) & movesOf<S>()) != 0;
+    }
+    template <Side S> vector<Move> getMoves();
+    template <Side S> bool doMove(Move *m);
+    template <Side S> int count() { return popcount(own<S>()); }
+    template <Side S> int score(int elapsedMoves);
+};
+
+/*
+ * A batch of positions in structure-of-arrays layout, so that one vector
+ * instruction can work on the same bitboard of several positions. Used to
+ * evaluate all the children of a node at once.
+ */
+struct BoardBatch {
+    // More than enough for the legal moves of any position.
+    static const int CAPACITY = 64;
+
+    int size = 0;
+    alignas(32) uint64_t black[CAPACITY], white[CAPACITY];
+    alignas(32) uint64_t black_moves[CAPACITY], white_moves[CAPACITY];
+    alignas(32) uint64_t black_stables[CAPACITY], white_stables[CAPACITY];
+
+    void add(const Board &board);
 };
 
+void scoreBatch(const BoardBatch &batch, Side side, int elapsedMoves, int *scores);
+template <Side S> void scoreBatch(const BoardBatch &batch, int elapsedMoves, int *scores);
+
 #endif
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "common.h"
+#include "protocol.h"
+using namespace std;
+
+/*
+ * Drop-in replacement for TVMA that plays through a running TVMAServer.
+ * It speaks the same text protocol as wrapper.cpp on stdin/stdout and
+ * forwards every move to the server at $TVMA_SOCKET (default
+ * /tmp/tvma.sock).
+ */
+
+bool request(int fd, const Request &req, Response &resp) {
+    return writeFrame(fd, &req, sizeof(req)) && readFrame(fd, &resp, sizeof(resp))
+        && resp.status == RESP_OK;
+}
+
+int main(int argc, char *argv[]) {
+    // Read in side the player is on.
+    if (argc != 2)  {
+        cerr << "usage: " << argv[0] << " side" << endl;
+        exit(-1);
+    }
+    Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
+
+    // Connect to the server and start a game.
+    const char *path = socketPath();
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+        cerr << "cannot connect to " << path << ": " << strerror(errno) << endl;
+        exit(-1);
+    }
+
+    Request req = { REQ_NEW_GAME, (uint8_t) side, -1, -1, 0, 0 };
+    Response resp;
+    if (!request(fd, req, resp)) {
+        cerr << "server refused a new game" << endl;
+        exit(-1);
+    }
+    uint32_t game = resp.game;
+
+    // Tell java wrapper that we are done initializing.
+    cout << "Init done" << endl;
+    cout.flush();
+
+    int moveX, moveY, msLeft;
+
+    // Get opponent's move and time left for player each turn.
+    while (cin >> moveX >> moveY >> msLeft) {
+        req = { REQ_MOVE, (uint8_t) side, (int8_t) moveX, (int8_t) moveY, msLeft, game };
+        if (!request(fd, req, resp)) {
+            cerr << "lost the server" << endl;
+            exit(-1);
+        }
+
+        cout << (int) resp.x << " " << (int) resp.y << endl;
+        cout.flush();
+    }
+
+    req = { REQ_END_GAME, (uint8_t) side, -1, -1, 0, game };
+    request(fd, req, resp);
+    close(fd);
+
+    return 0;
+}
@@ -12,6 +12,8 @@ enum Side {
 
 #define OPPOSITE(x) ((x) == BLACK ? WHITE : BLACK)
 
+inline int popcount(uint64_t x) { return __builtin_popcountll(x); }
+
 class Move {
 public:
     int8_t x, y;
@@ -1,3 +1,8 @@
+#ifndef __CONSTANTS_H__
+#define __CONSTANTS_H__
+
+#include <cstdint>
+
 inline constexpr uint64_t getSinglePosition(int x, int y) {
     return (0x8000000000000000ull >> (8 * y)) >> x;
 }
@@ -11,72 +16,99 @@ inline constexpr uint64_t SOUEAST(uint64_t x) { return SOUTH(EAST(x)); }
 inline constexpr uint64_t NORWEST(uint64_t x) { return NORTH(WEST(x)); }
 inline constexpr uint64_t SOUWEST(uint64_t x) { return SOUTH(WEST(x)); }
 
-// A bitboard for each diagonal on the board.
-uint64_t diagonals[] = {
-    9223372036854775808ull,
-    4647714815446351872ull,
-    2323998145211531264ull,
-    1161999622361579520ull,
-    580999813328273408ull,
-    290499906672525312ull,
-    145249953336295424ull,
-    72624976668147840ull,
-    283691315109952ull,
-    1108169199648ull,
-    4328785936ull,
-    16909320ull,
-    66052ull,
-    258ull,
-    1ull
+// A fixed-size table of bitboards that can be filled in by a constexpr
+// function, so every lookup table below is built by the compiler.
+template <int N>
+struct BitboardTable {
+    uint64_t v[N];
+    constexpr uint64_t operator[](int i) const { return v[i]; }
 };
 
+// Builds the table whose entry i has every square (x, y) with
+// line(x, y) == i.
+template <int N, typename Line>
+constexpr BitboardTable<N> makeLines(Line line) {
+    BitboardTable<N> table = {};
+    for (int x = 0; x < 8; x++)
+        for (int y = 0; y < 8; y++)
+            table.v[line(x, y)] |= getSinglePosition(x, y);
+    return table;
+}
+
+constexpr int diagonalIndex(int x, int y) { return x + y; }
+constexpr int antiDiagonalIndex(int x, int y) { return 7 - x + y; }
+constexpr int rowIndex(int x, int y) { return y; }
+constexpr int columnIndex(int x, int y) { return x; }
+
+// A bitboard for each diagonal on the board.
+constexpr BitboardTable<15> diagonals = makeLines<15>(diagonalIndex);
+
 // A bitboard for every top-right-to-bottom-left diagonal on the board
-uint64_t anti_diagonals[] = {
-    72057594037927936ull,
-    144396663052566528ull,
-    288794425616760832ull,
-    577588855528488960ull,
-    1155177711073755136ull,
-    2310355422147575808ull,
-    4620710844295151872ull,
-    9241421688590303745ull,
-    36099303471055874ull,
-    141012904183812ull,
-    550831656968ull,
-    2151686160ull,
-    8405024ull,
-    32832ull,
-    128ull
-};
+constexpr BitboardTable<15> anti_diagonals = makeLines<15>(antiDiagonalIndex);
 
 //A bitboard for every row
-uint64_t rows[] = {
-    18374686479671623680ull,
-    71776119061217280ull,
-    280375465082880ull,
-    1095216660480ull,
-    4278190080ull,
-    16711680ull,
-    65280ull,
-    255ull
+constexpr BitboardTable<8> rows = makeLines<8>(rowIndex);
+
+constexpr BitboardTable<8> columns = makeLines<8>(columnIndex);
+
+static_assert(diagonals[1] == 4647714815446351872ull, "diagonals are indexed by x + y");
+static_assert(anti_diagonals[7] == 9241421688590303745ull, "anti-diagonals are indexed by 7 - x + y");
+static_assert(rows[0] == 18374686479671623680ull && columns[7] == 72340172838076673ull,
+              "rows and columns are indexed from the top left");
+
+// Flip tables for Board::flips. Each line through the square of a move (its
+// row, column, diagonal and anti-diagonal) is read as a byte, with the
+// square of the move at bit p.
+//
+// lineOutflank[p][o]: the squares just past the run of opponent discs on each
+// side of p, where 'o' is the opponent's discs on the six inner squares of
+// the line (bits 1 to 6, shifted down by one); the end squares can never be
+// turned over, so they are left out of the index. A disc of the mover on
+// one of these squares brackets the run.
+//
+// lineFlips[p][f]: the squares between p and the bracketing discs 'f'.
+struct OutflankTable {
+    uint8_t v[8][64];
+    constexpr OutflankTable() : v() {
+        for (int p = 0; p < 8; p++) {
+            for (int o = 0; o < 64; o++) {
+                int opponent = o << 1, q = 0;
+                for (q = p + 1; q < 7 && (opponent >> q & 1); q++)
+                    ;
+                if (q > p + 1 && q < 8)
+                    v[p][o] |= 1 << q;
+                for (q = p - 1; q > 0 && (opponent >> q & 1); q--)
+                    ;
+                if (q < p - 1 && q >= 0)
+                    v[p][o] |= 1 << q;
+            }
+        }
+    }
 };
 
-uint64_t columns[] = {
-    9259542123273814144ull,
-    4629771061636907072ull,
-    2314885530818453536ull,
-    1157442765409226768ull,
-    578721382704613384ull,
-    289360691352306692ull,
-    144680345676153346ull,
-    72340172838076673ull
+struct FlippedTable {
+    uint8_t v[8][256];
+    constexpr FlippedTable() : v() {
+        for (int p = 0; p < 8; p++)
+            for (int f = 0; f < 256; f++)
+                for (int q = 0; q < 8; q++)
+                    if (f >> q & 1)
+                        for (int r = (q < p ? q : p) + 1; r < (q < p ? p : q); r++)
+                            v[p][f] |= 1 << r;
+    }
 };
 
+constexpr OutflankTable lineOutflank;
+constexpr FlippedTable lineFlips;
+
+static_assert(lineOutflank.v[0][0x03] == 0x08 && lineFlips.v[0][0x08] == 0x06,
+              "a move at bit 0 brackets two discs with a disc at bit 3");
+
 // A bitboard with all four corners marked
-uint64_t all_corners = getSinglePosition(0, 0)
-                     | getSinglePosition(0, 7)
-                     | getSinglePosition(7, 0)
-                     | getSinglePosition(7, 7);
+constexpr uint64_t all_corners = getSinglePosition(0, 0)
+                               | getSinglePosition(0, 7)
+                               | getSinglePosition(7, 0)
+                               | getSinglePosition(7, 7);
 
 // A modified matrix from the old one,
 // This matrix only characterizes the specific utility of each piece
@@ -84,7 +116,7 @@ uint64_t all_corners = getSinglePosition(0, 0)
 // However, corners are VERY useful, and therefore weighted 50.
 // This is a good metric that approximates the "corner heuristic" for
 // other engines. 
-int utilityMatrix[8][8] =
+constexpr int utilityMatrix[8][8] =
 {{50,-2, 2, 2, 2, 2,-2, 50},
  {-2,-9, 0, 0, 0, 0,-9,-2 },
  { 2, 1, 0, 0, 0, 1, 0, 2 },
@@ -93,3 +125,78 @@ int utilityMatrix[8][8] =
  { 2, 1, 1, 0, 0, 1, 0, 2 },
  {-2,-9, 0, 0, 0, 0,-9,-2 },
  {50,-2, 2, 2, 2, 2,-2, 50}};
+
+// The distinct non-zero weights appearing in utilityMatrix. The evaluation
+// scores the matrix as a weighted sum of popcounts over one mask per weight.
+constexpr int utilityWeights[] = { 50, 2, 1, -2, -9 };
+constexpr int NUM_UTILITY_WEIGHTS = sizeof(utilityWeights) / sizeof(utilityWeights[0]);
+
+// Bitboard of every square whose utilityMatrix entry equals 'weight'.
+constexpr uint64_t utilityMask(int weight) {
+    uint64_t mask = 0;
+    for (int x = 0; x < 8; x++)
+        for (int y = 0; y < 8; y++)
+            if (utilityMatrix[x][y] == weight)
+                mask |= getSinglePosition(x, y);
+    return mask;
+}
+
+constexpr uint64_t utilityMasks[] = {
+    utilityMask(utilityWeights[0]),
+    utilityMask(utilityWeights[1]),
+    utilityMask(utilityWeights[2]),
+    utilityMask(utilityWeights[3]),
+    utilityMask(utilityWeights[4])
+};
+
+// Parities are 16.16 fixed point: PARITY_ONE stands for 1.0.
+#define PARITY_SHIFT 16
+constexpr int64_t PARITY_ONE = 1ll << PARITY_SHIFT;
+
+// parityReciprocal[n] is 100 / n in fixed point, so the parity
+// 100 * (a - b) / (a + b) becomes (a - b) * parityReciprocal[a + b]
+// without a division. Entry 0 is 0, which makes an empty pair score 0.
+struct ParityTable {
+    int32_t v[129];
+    constexpr ParityTable() : v() {
+        for (int n = 1; n < 129; n++)
+            v[n] = (int32_t) ((100 * PARITY_ONE + n / 2) / n);
+    }
+    constexpr int32_t operator[](int n) const { return v[n]; }
+};
+
+constexpr ParityTable parityReciprocal;
+
+// Weights of each term of the evaluation, in hundredths, for each phase of
+// the game. 'total' is what the weighted sum is divided by.
+template <int Phase> struct PhaseWeights;
+
+// Opening: moves 0-19.
+template <> struct PhaseWeights<0> {
+    static constexpr int utility = 55, mobility = 50, coins = 5, stables = 0;
+    static constexpr int total = 110;
+};
+
+// Early midgame: moves 20-29.
+template <> struct PhaseWeights<1> {
+    static constexpr int utility = 55, mobility = 50, coins = -5, stables = 30;
+    static constexpr int total = 130;
+};
+
+// Late midgame: moves 30-39.
+template <> struct PhaseWeights<2> {
+    static constexpr int utility = 55, mobility = 50, coins = -5, stables = 40;
+    static constexpr int total = 140;
+};
+
+// Endgame: moves 40 and later.
+template <> struct PhaseWeights<3> {
+    static constexpr int utility = 40, mobility = 20, coins = 15, stables = 50;
+    static constexpr int total = 185;
+};
+
+inline constexpr int gamePhase(int elapsedMoves) {
+    return elapsedMoves < 20 ? 0 : elapsedMoves < 30 ? 1 : elapsedMoves < 40 ? 2 : 3;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __CORPUS_H__
+#define __CORPUS_H__
+
+#include "player.h"
+
+/*
+ * A fixed set of realistic positions for benchmarks, taken from games the
+ * engine plays against itself. The first few moves of each game are chosen
+ * by a seeded generator and the rest by a fixed-depth search, so the corpus
+ * is the same on every run and every machine.
+ */
+
+struct BenchPosition {
+    Board board;
+    Side side;
+    int elapsedMoves;
+};
+
+inline vector<BenchPosition> gamePositions(int games = 8, int depth = 3) {
+    vector<BenchPosition> positions;
+    uint32_t seed = 20141;
+
+    for (int game = 0; game < games; game++) {
+        Board board;
+        Side side = BLACK;
+
+        for (int elapsed = 0; !board.isDone(); elapsed++) {
+            if (!board.hasMoves(side)) {
+                side = OPPOSITE(side);
+                continue;
+            }
+
+            positions.push_back({ board, side, elapsed });
+
+            Move move;
+            if (elapsed < 6) {
+                vector<Move> moves = board.getMoves(side);
+                seed = seed * 1103515245 + 12345;
+                move = moves[(seed >> 16) % moves.size()];
+            } else {
+                Player player(side);
+                *player.board = board;
+                player.elapsed_moves = elapsed;
+                player.setSearchLimits(0, depth);
+                move = player.getBestMove();
+            }
+
+            board.doMove(&move, side);
+            side = OPPOSITE(side);
+        }
+    }
+
+    return positions;
+}
+
+#endif
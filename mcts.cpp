@@ -0,0 +1,249 @@
+#include "mcts.h"
+#include <cmath>
+#include <thread>
+#include <vector>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+unsigned long currentTimeMillis();
+
+// Weight of the exploration term of UCT, for results scored from 0 to 1.
+#define MCTS_EXPLORATION 1.0
+
+// The longest line a playout can descend in the tree: every ply either fills
+// a square or passes, and there are never two passes in a row.
+#define MCTS_MAX_PATH 128
+
+inline uint64_t xorshift(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+/*
+ * Picks one of the set bits of 'moves' at random.
+ */
+inline uint64_t randomBit(uint64_t moves, uint64_t &rng) {
+    int n = (int) (xorshift(rng) % popcount(moves));
+#ifdef __BMI2__
+    return _pdep_u64(1ull << n, moves);
+#else
+    while (n--)
+        moves &= moves - 1;
+    return moves & -moves;
+#endif
+}
+
+/*
+ * Plays 'bit' for 'own' and swaps the sides, so that 'own' is again the side
+ * to move.
+ */
+inline void playBit(uint64_t bit, uint64_t &own, uint64_t &other) {
+    int square = 63 - __builtin_ctzll(bit);
+    uint64_t flipped = Board::flips(square % 8, square / 8, own, other);
+    uint64_t mover = own | flipped | bit;
+    own = other & ~flipped;
+    other = mover;
+}
+
+int randomPlayout(uint64_t own, uint64_t other, uint64_t &rng) {
+    bool swapped = false;
+    bool passed = false;
+
+    for (;;) {
+        uint64_t moves = Board::mobility(own, other);
+        if (moves) {
+            if (moves & all_corners)
+                moves &= all_corners;
+            playBit(randomBit(moves, rng), own, other);
+            passed = false;
+        } else if (!passed) {
+            std::swap(own, other);
+            passed = true;
+        } else {
+            break;
+        }
+        swapped = !swapped;
+    }
+
+    int diff = popcount(own) - popcount(other);
+    return swapped ? -diff : diff;
+}
+
+MCTS::MCTS(uint32_t poolSize)
+    : playouts(0), pool(new MCTSNode[poolSize]), poolSize(poolSize), used(0) {
+}
+
+/*
+ * Takes 'count' nodes from the pool, or returns 0 (the root, never a child)
+ * if it has run out.
+ */
+static uint32_t allocate(std::atomic<uint32_t> &used, uint32_t poolSize, uint32_t count) {
+    // Checked first so that a full pool stops the counter from growing.
+    if (used.load(std::memory_order_relaxed) + count > poolSize)
+        return 0;
+    uint32_t first = used.fetch_add(count, std::memory_order_relaxed);
+    if (first + count > poolSize)
+        return 0;
+    return first;
+}
+
+static void initNode(MCTSNode &node, Move move) {
+    node.visits.store(0, std::memory_order_relaxed);
+    node.score.store(0, std::memory_order_relaxed);
+    node.firstChild.store(0, std::memory_order_relaxed);
+    node.state.store(0, std::memory_order_relaxed);
+    node.childCount = 0;
+    node.move = move;
+}
+
+/*
+ * Gives 'node' a child for every move of 'own' against 'other', or a single
+ * pass child if 'own' has to pass. Only one thread can win the race to
+ * expand a node; the others go on with a playout from it. Returns false if
+ * this thread did not expand it, or if the pool is full.
+ */
+bool MCTS::expand(MCTSNode &node, uint64_t own, uint64_t other) {
+    uint8_t leaf = 0;
+    if (!node.state.compare_exchange_strong(leaf, 1, std::memory_order_acquire))
+        return false;
+
+    uint64_t moves = Board::mobility(own, other);
+    uint32_t count = (moves ? popcount(moves) : 1);
+    uint32_t first = allocate(used, poolSize, count);
+    if (!first) {
+        node.state.store(0, std::memory_order_release);
+        return false;
+    }
+
+    if (!moves) {
+        initNode(pool[first], Move(-1, -1));
+    } else {
+        for (uint32_t i = first; moves; moves &= moves - 1, i++) {
+            int square = 63 - __builtin_ctzll(moves);
+            initNode(pool[i], Move(square % 8, square / 8));
+        }
+    }
+
+    node.childCount = count;
+    node.firstChild.store(first, std::memory_order_relaxed);
+    node.state.store(2, std::memory_order_release);
+    return true;
+}
+
+/*
+ * UCT: the child with the best mean result plus exploration bonus. Visits
+ * still in flight count as losses, which keeps the threads apart.
+ */
+uint32_t MCTS::select(MCTSNode &node) {
+    uint32_t first = node.firstChild.load(std::memory_order_relaxed);
+    double logVisits = std::log((double) node.visits.load(std::memory_order_relaxed) + 1);
+
+    uint32_t best = first;
+    double bestValue = -1;
+    for (uint32_t i = first; i < first + node.childCount; i++) {
+        int32_t visits = pool[i].visits.load(std::memory_order_relaxed);
+        if (!visits)
+            return i;
+
+        double value = pool[i].score.load(std::memory_order_relaxed) / (2.0 * visits)
+                     + MCTS_EXPLORATION * std::sqrt(logVisits / visits);
+        if (value > bestValue) {
+            bestValue = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void MCTS::worker(int thread) {
+    uint64_t rng = 0x9e3779b97f4a7c15ull * (thread + 1);
+    uint32_t path[MCTS_MAX_PATH];
+
+    while (!stop.load(std::memory_order_relaxed)) {
+        uint64_t own = (rootSide == BLACK ? rootBoard.black : rootBoard.white);
+        uint64_t other = (rootSide == BLACK ? rootBoard.white : rootBoard.black);
+        int length = 0;
+
+        // Descend, counting the visit on the way down as a virtual loss.
+        uint32_t index = 0;
+        pool[0].visits.fetch_add(1, std::memory_order_relaxed);
+        path[length++] = 0;
+
+        for (;;) {
+            MCTSNode &node = pool[index];
+            if (node.state.load(std::memory_order_acquire) != 2) {
+                // A leaf is only expanded on its second visit, so that
+                // lines tried once do not use up the pool.
+                if (node.visits.load(std::memory_order_relaxed) < 2 ||
+                    !expand(node, own, other))
+                    break;
+            }
+
+            index = select(node);
+            MCTSNode &child = pool[index];
+            if (child.move.x >= 0)
+                playBit(getSinglePosition(child.move.x, child.move.y), own, other);
+            else
+                std::swap(own, other);
+
+            child.visits.fetch_add(1, std::memory_order_relaxed);
+            path[length++] = index;
+
+            if (!Board::mobility(own, other) && !Board::mobility(other, own))
+                break;
+        }
+
+        // Each node is scored for the side that moved into it, which is the
+        // side not to move at that node.
+        int result = randomPlayout(own, other, rng);
+        for (int i = length - 1; i >= 0; i--) {
+            result = -result;
+            pool[path[i]].score.fetch_add(result > 0 ? 2 : result == 0 ? 1 : 0,
+                                          std::memory_order_relaxed);
+        }
+
+        uint64_t n = playoutCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (maxPlayouts ? n >= maxPlayouts : (n % 16 == 0 && currentTimeMillis() > deadline))
+            stop.store(true, std::memory_order_relaxed);
+    }
+}
+
+Move MCTS::search(const Board &root, Side side, int threads,
+                  unsigned long deadline, uint64_t maxPlayouts) {
+    rootBoard = root;
+    rootSide = side;
+    this->deadline = deadline;
+    this->maxPlayouts = maxPlayouts;
+    playoutCount.store(0);
+    stop.store(false);
+
+    used.store(1);
+    initNode(pool[0], Move(-1, -1));
+
+    uint64_t own = (side == BLACK ? root.black : root.white);
+    uint64_t other = (side == BLACK ? root.white : root.black);
+    if (!Board::mobility(own, other) || !expand(pool[0], own, other)) {
+        playouts = 0;
+        return Move(-1, -1);
+    }
+
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; i++)
+        helpers.emplace_back(&MCTS::worker, this, i);
+    worker(0);
+    for (std::thread &helper : helpers)
+        helper.join();
+
+    playouts = playoutCount.load();
+
+    MCTSNode &node = pool[0];
+    uint32_t first = node.firstChild.load(), best = first;
+    for (uint32_t i = first; i < first + node.childCount; i++) {
+        if (pool[i].visits.load() > pool[best].visits.load())
+            best = i;
+    }
+    return pool[best].move;
+}
@@ -0,0 +1,74 @@
+#ifndef __MCTS_H__
+#define __MCTS_H__
+
+#include <atomic>
+#include <memory>
+#include "common.h"
+#include "board.h"
+
+/*
+ * Monte Carlo tree search, as an alternative to the alpha-beta search.
+ *
+ * The tree lives in a fixed arena of nodes handed out with an atomic bump
+ * pointer, and is searched by several threads at once (tree parallelism).
+ * A thread counts its visit on every node of its path before its playout
+ * finishes, which acts as a virtual loss: the other threads see that line
+ * as less promising until the result comes in, and spread out over the
+ * tree. Playouts run on raw bitboards with a light policy: take a corner
+ * when there is one, otherwise a random move.
+ */
+
+// Playouts per ply of a depth limit (Player::setSearchLimits()), which has
+// no direct meaning for this search. At depth 7 this takes about as long as
+// alpha-beta does on the bench corpus, some 20 ms per position.
+#define MCTS_PLAYOUTS_PER_PLY 1000
+
+struct MCTSNode {
+    std::atomic<int32_t> visits;
+    // Two points per win and one per draw, for the side that played 'move'.
+    std::atomic<int32_t> score;
+    std::atomic<uint32_t> firstChild;
+    // 0 for a leaf, 1 while a thread is expanding it, 2 once it has children.
+    std::atomic<uint8_t> state;
+    uint8_t childCount;
+    Move move;
+};
+
+class MCTS {
+public:
+    MCTS(uint32_t poolSize = 1 << 21);
+
+    // Searches until 'deadline' (in currentTimeMillis() units), or for
+    // 'maxPlayouts' playouts if it is not 0, and returns the most visited
+    // move, or (-1, -1) if 'side' has to pass.
+    Move search(const Board &root, Side side, int threads,
+                unsigned long deadline, uint64_t maxPlayouts);
+
+    // Playouts run by the last search.
+    uint64_t playouts;
+
+private:
+    void worker(int thread);
+    bool expand(MCTSNode &node, uint64_t own, uint64_t other);
+    uint32_t select(MCTSNode &node);
+
+    std::unique_ptr<MCTSNode[]> pool;
+    uint32_t poolSize;
+    std::atomic<uint32_t> used;
+
+    std::atomic<uint64_t> playoutCount;
+    std::atomic<bool> stop;
+    Board rootBoard;
+    Side rootSide;
+    unsigned long deadline;
+    uint64_t maxPlayouts;
+};
+
+/*
+ * Plays random moves (corners first) from the given discs, 'own' to move,
+ * until the game ends. Returns the final disc differential for 'own'.
+ * 'rng' is the state of a xorshift generator, and must not be 0.
+ */
+int randomPlayout(uint64_t own, uint64_t other, uint64_t &rng);
+
+#endif
@@ -0,0 +1,282 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+#include "corpus.h"
+using namespace std;
+
+/*
+ * Times the Board primitives over the fixed corpus of game positions from
+ * corpus.h.
+ *
+ *   microbench [repetitions]
+ *       Prints one line per primitive: nanoseconds, cycles (rdtsc) and
+ *       instructions (perf_event_open) per call. A column reads '-' where
+ *       the counter is not available.
+ *
+ *   microbench compare before.txt after.txt
+ *       Compares two saved runs side by side, e.g. of two builds.
+ *
+ *   microbench verify [boards]
+ *       Checks the table-driven Board::flips against the square by square
+ *       doDirection() on every empty square of random boards, for both sides.
+ */
+
+/*
+ * Counts the instructions retired by this process in user space, if the
+ * kernel lets us.
+ */
+class InstructionCounter {
+public:
+    InstructionCounter() {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~InstructionCounter() { if (fd >= 0) close(fd); }
+
+    bool available() { return fd >= 0; }
+    void start() {
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t stop() {
+        uint64_t count = 0;
+        if (fd < 0) return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) != sizeof(count))
+            return 0;
+        return count;
+    }
+
+private:
+    int fd;
+};
+
+inline uint64_t readCycles() {
+#ifdef HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Results are folded into this so the compiler cannot drop the calls.
+volatile uint64_t sink;
+
+struct Result {
+    double ns, cycles, instructions;
+};
+
+/*
+ * Runs 'body' (which makes 'calls' calls of the primitive) 'repetitions'
+ * times and returns the cost per call.
+ */
+template <typename Body>
+Result measure(InstructionCounter &counter, int repetitions, size_t calls, Body body) {
+    body(); // warm up
+
+    auto start = chrono::steady_clock::now();
+    uint64_t startCycles = readCycles();
+    counter.start();
+
+    for (int i = 0; i < repetitions; i++)
+        body();
+
+    uint64_t instructions = counter.stop();
+    uint64_t cycles = readCycles() - startCycles;
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    double total = (double) repetitions * calls;
+    return { ns / total, cycles / total, instructions / total };
+}
+
+void printResult(const string &name, const Result &r, bool haveCycles, bool haveInstructions) {
+    cout << name << "\t" << r.ns << "\t";
+    if (haveCycles) cout << r.cycles; else cout << "-";
+    cout << "\t";
+    if (haveInstructions) cout << r.instructions; else cout << "-";
+    cout << endl;
+}
+
+int run(int repetitions) {
+    vector<BenchPosition> corpus = gamePositions();
+
+    struct MoveCase { Board board; Side side; Move move; };
+    vector<MoveCase> moveCases;
+    for (BenchPosition &p : corpus)
+        for (Move &move : p.board.getMoves(p.side))
+            moveCases.push_back({ p.board, p.side, move });
+
+    InstructionCounter counter;
+#ifdef HAVE_RDTSC
+    bool haveCycles = true;
+#else
+    bool haveCycles = false;
+#endif
+
+    cout << "# " << corpus.size() << " positions, " << moveCases.size() << " moves, "
+         << repetitions << " repetitions\n"
+         << "# primitive\tns/op\tcycles/op\tinstructions/op" << endl;
+
+    printResult("generateMoves", measure(counter, repetitions, corpus.size(), [&] {
+        for (BenchPosition &p : corpus) {
+            Board b(p.board);
+            b.generateMoves();
+            sink += b.black_moves;
+        }
+    }), haveCycles, counter.available());
+
+    printResult("generateStablePieces", measure(counter, repetitions, corpus.size(), [&] {
+        for (BenchPosition &p : corpus)
+            sink += p.board.generateStablePieces(p.side);
+    }), haveCycles, counter.available());
+
+    printResult("doMove", measure(counter, repetitions, moveCases.size(), [&] {
+        for (MoveCase &c : moveCases) {
+            Board b(c.board);
+            b.doMove(&c.move, c.side);
+            sink += b.black;
+        }
+    }), haveCycles, counter.available());
+
+    printResult("getMoves", measure(counter, repetitions, corpus.size(), [&] {
+        for (BenchPosition &p : corpus)
+            sink += p.board.getMoves(p.side).size();
+    }), haveCycles, counter.available());
+
+    printResult("score", measure(counter, repetitions, corpus.size(), [&] {
+        for (BenchPosition &p : corpus)
+            sink += p.board.score(p.side, p.elapsedMoves);
+    }), haveCycles, counter.available());
+
+    printResult("count", measure(counter, repetitions, corpus.size(), [&] {
+        for (BenchPosition &p : corpus)
+            sink += p.board.count(p.side);
+    }), haveCycles, counter.available());
+
+    return 0;
+}
+
+/*
+ * Reads a saved run into name -> columns.
+ */
+map<string, vector<string>> readRun(const char *path) {
+    map<string, vector<string>> rows;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        string name, value;
+        fields >> name;
+        while (fields >> value)
+            rows[name].push_back(value);
+    }
+    return rows;
+}
+
+int compare(const char *before, const char *after) {
+    map<string, vector<string>> a = readRun(before), b = readRun(after);
+
+    cout << "# primitive\tns/op before\tns/op after\tspeedup\tinstructions before\tinstructions after" << endl;
+    for (auto &row : a) {
+        auto other = b.find(row.first);
+        if (other == b.end() || row.second.size() < 3 || other->second.size() < 3)
+            continue;
+
+        double nsBefore = atof(row.second[0].c_str()), nsAfter = atof(other->second[0].c_str());
+        cout << row.first << "\t" << nsBefore << "\t" << nsAfter << "\t"
+             << (nsAfter > 0 ? nsBefore / nsAfter : 0) << "x\t"
+             << row.second[2] << "\t" << other->second[2] << endl;
+    }
+    return 0;
+}
+
+int verify(int boards) {
+    mt19937_64 rng(2014);
+    uint64_t (*directions[])(uint64_t) = { NORTH, SOUTH, EAST, WEST, NOREAST, NORWEST, SOUEAST, SOUWEST };
+    uint64_t checked = 0, mismatches = 0;
+
+    for (int i = 0; i < boards; i++) {
+        // Anything from a nearly empty to a nearly full board.
+        uint64_t occupied = rng();
+        for (int fill = i % 4; fill > 0; fill--)
+            occupied |= rng();
+        if (i % 8 == 7)
+            occupied &= rng();
+
+        Board board;
+        board.black = occupied & rng();
+        board.white = occupied & ~board.black;
+
+        for (int x = 0; x < 8; x++) {
+            for (int y = 0; y < 8; y++) {
+                if (occupied & getSinglePosition(x, y))
+                    continue;
+                for (Side side : { BLACK, WHITE }) {
+                    uint64_t expected = 0;
+                    for (auto direction : directions)
+                        expected |= board.doDirection(x, y, side, direction);
+                    expected &= ~getSinglePosition(x, y);
+
+                    uint64_t own = (side == BLACK ? board.black : board.white);
+                    uint64_t other = (side == BLACK ? board.white : board.black);
+                    uint64_t actual = Board::flips(x, y, own, other);
+
+                    checked++;
+                    if (actual != expected && mismatches++ < 10) {
+                        cerr << "mismatch at (" << x << ", " << y << ") for "
+                             << (side == BLACK ? "black" : "white") << ": black " << hex << board.black
+                             << ", white " << board.white << ", expected " << expected
+                             << ", got " << actual << dec << endl;
+                    }
+                }
+            }
+        }
+    }
+
+    cout << checked << " moves checked, " << mismatches << " mismatches" << endl;
+    return mismatches ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 4 && !strcmp(argv[1], "compare"))
+        return compare(argv[2], argv[3]);
+    if (argc >= 2 && argc <= 3 && !strcmp(argv[1], "verify"))
+        return verify(argc == 3 ? atoi(argv[2]) : 100000);
+    if (argc <= 2) {
+        // atoi() reads anything that is not a number as 0, so this also
+        // turns away e.g. "microbench help".
+        int repetitions = (argc == 2 ? atoi(argv[1]) : 200);
+        if (repetitions >= 1)
+            return run(repetitions);
+    }
+
+    cerr << "usage: " << argv[0] << " [repetitions]\n"
+         << "       " << argv[0] << " compare before.txt after.txt\n"
+         << "       " << argv[0] << " verify [boards]" << endl;
+    return -1;
+}
@@ -0,0 +1,258 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "player.h"
+#include "symmetry.h"
+using namespace std;
+
+/*
+ * Trains the network evaluator (nnue.h) on self-play games and writes a
+ * weight file for TVMA --nnue.
+ *
+ *   nntrain weights.bin [games] [epochs] [depth]
+ *
+ * The engine plays 'games' games against itself with its handwritten
+ * evaluation at a fixed 'depth', with some random moves mixed in for
+ * variety. Every position is labelled with the final disc differential of
+ * its game. A float copy of the network is trained on them with Adam, with
+ * each sample seen under a random one of the board's eight symmetries, and
+ * is then quantized to the integer format the engine uses.
+ */
+
+struct Sample {
+    uint64_t black, white;
+    float target; // final white - black disc count, divided by 64
+};
+
+vector<Sample> selfPlay(int games, int depth, mt19937 &rng) {
+    vector<Sample> samples;
+
+    for (int game = 0; game < games; game++) {
+        Board board;
+        Side side = BLACK;
+        size_t first = samples.size();
+
+        for (int elapsed = 0; !board.isDone(); elapsed++) {
+            if (!board.hasMoves(side)) {
+                side = OPPOSITE(side);
+                continue;
+            }
+
+            samples.push_back({ board.black, board.white, 0 });
+
+            Move move;
+            vector<Move> moves = board.getMoves(side);
+            if (elapsed < 4 || rng() % 10 == 0) {
+                move = moves[rng() % moves.size()];
+            } else {
+                Player player(side);
+                *player.board = board;
+                player.elapsed_moves = elapsed;
+                player.setSearchLimits(0, depth);
+                move = player.getBestMove();
+            }
+
+            board.doMove(&move, side);
+            side = OPPOSITE(side);
+        }
+
+        float result = (board.countWhite() - board.countBlack()) / 64.0f;
+        for (size_t i = first; i < samples.size(); i++)
+            samples[i].target = result;
+
+        if ((game + 1) % 100 == 0)
+            cerr << "played " << game + 1 << " games, " << samples.size() << " positions" << endl;
+    }
+
+    return samples;
+}
+
+/*
+ * The network in floating point, with one flat parameter vector so that the
+ * optimizer can treat every parameter alike.
+ */
+struct FloatNetwork {
+    static const int W1 = 0;
+    static const int B1 = W1 + NN_INPUTS * NN_HIDDEN1;
+    static const int W2 = B1 + NN_HIDDEN1;
+    static const int B2 = W2 + NN_HIDDEN2 * NN_HIDDEN1;
+    static const int W3 = B2 + NN_HIDDEN2;
+    static const int B3 = W3 + NN_HIDDEN2;
+    static const int SIZE = B3 + 1;
+
+    vector<float> p, grad, m, v;
+    int steps = 0;
+
+    FloatNetwork(mt19937 &rng) : p(SIZE), grad(SIZE), m(SIZE), v(SIZE) {
+        uniform_real_distribution<float> small(-0.1f, 0.1f);
+        uniform_real_distribution<float> layer(-1 / sqrt((float) NN_HIDDEN1), 1 / sqrt((float) NN_HIDDEN1));
+        for (int i = W1; i < B1; i++) p[i] = small(rng);
+        for (int i = B1; i < W2; i++) p[i] = 0.5f;
+        for (int i = W2; i < B2; i++) p[i] = layer(rng);
+        for (int i = W3; i < B3; i++) p[i] = layer(rng);
+    }
+
+    float w1(int f, int i) const { return p[W1 + f * NN_HIDDEN1 + i]; }
+    float w2(int j, int i) const { return p[W2 + j * NN_HIDDEN1 + i]; }
+
+    /*
+     * Forward pass; if 'train', also accumulates the gradient of the squared
+     * error, scaled by 'scale'.
+     */
+    float run(uint64_t black, uint64_t white, float target, bool train, float scale) {
+        int features[64], count = 0;
+        for (; black; black &= black - 1)
+            features[count++] = networkFeature(BLACK, __builtin_ctzll(black));
+        for (; white; white &= white - 1)
+            features[count++] = networkFeature(WHITE, __builtin_ctzll(white));
+
+        float z1[NN_HIDDEN1], a1[NN_HIDDEN1], z2[NN_HIDDEN2], a2[NN_HIDDEN2];
+        for (int i = 0; i < NN_HIDDEN1; i++) {
+            z1[i] = p[B1 + i];
+            for (int k = 0; k < count; k++)
+                z1[i] += w1(features[k], i);
+            a1[i] = min(max(z1[i], 0.0f), 1.0f);
+        }
+
+        float y = p[B3];
+        for (int j = 0; j < NN_HIDDEN2; j++) {
+            z2[j] = p[B2 + j];
+            for (int i = 0; i < NN_HIDDEN1; i++)
+                z2[j] += w2(j, i) * a1[i];
+            a2[j] = min(max(z2[j], 0.0f), 1.0f);
+            y += p[W3 + j] * a2[j];
+        }
+
+        float error = y - target;
+        if (!train)
+            return error * error;
+
+        float dy = 2 * error * scale;
+        float da1[NN_HIDDEN1] = {};
+        grad[B3] += dy;
+        for (int j = 0; j < NN_HIDDEN2; j++) {
+            grad[W3 + j] += dy * a2[j];
+            float dz2 = (z2[j] > 0 && z2[j] < 1) ? dy * p[W3 + j] : 0;
+            grad[B2 + j] += dz2;
+            for (int i = 0; i < NN_HIDDEN1; i++) {
+                grad[W2 + j * NN_HIDDEN1 + i] += dz2 * a1[i];
+                da1[i] += dz2 * w2(j, i);
+            }
+        }
+        for (int i = 0; i < NN_HIDDEN1; i++) {
+            float dz1 = (z1[i] > 0 && z1[i] < 1) ? da1[i] : 0;
+            grad[B1 + i] += dz1;
+            for (int k = 0; k < count; k++)
+                grad[W1 + features[k] * NN_HIDDEN1 + i] += dz1;
+        }
+
+        return error * error;
+    }
+
+    /*
+     * One Adam step, then clamps the weights to what the integer format can
+     * hold without overflowing the accumulator.
+     */
+    void step(float rate) {
+        const float beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+        steps++;
+        float correction1 = 1 - pow(beta1, steps), correction2 = 1 - pow(beta2, steps);
+
+        for (int i = 0; i < SIZE; i++) {
+            m[i] = beta1 * m[i] + (1 - beta1) * grad[i];
+            v[i] = beta2 * v[i] + (1 - beta2) * grad[i] * grad[i];
+            p[i] -= rate * (m[i] / correction1) / (sqrt(v[i] / correction2) + epsilon);
+            grad[i] = 0;
+        }
+
+        for (int i = W1; i < W2; i++)
+            p[i] = min(max(p[i], -2.0f), 2.0f);
+        for (int i = W2; i < SIZE; i++)
+            p[i] = min(max(p[i], -8.0f), 8.0f);
+    }
+
+    void quantize(Network &net) const {
+        auto q = [](float x, float scale) { return (int32_t) lround(x * scale); };
+        const float a = NN_ACTIVATION_ONE, w = NN_WEIGHT_ONE;
+
+        for (int f = 0; f < NN_INPUTS; f++)
+            for (int i = 0; i < NN_HIDDEN1; i++)
+                net.w1[f][i] = q(w1(f, i), a);
+        for (int i = 0; i < NN_HIDDEN1; i++)
+            net.b1[i] = q(p[B1 + i], a);
+        for (int j = 0; j < NN_HIDDEN2; j++) {
+            for (int i = 0; i < NN_HIDDEN1; i++)
+                net.w2[j][i] = q(w2(j, i), w);
+            net.b2[j] = q(p[B2 + j], a * w);
+            net.w3[j] = q(p[W3 + j], w);
+        }
+        net.b3 = q(p[B3], a * w);
+        net.computeFlipRows();
+    }
+};
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 5) {
+        cerr << "usage: " << argv[0] << " weights.bin [games] [epochs] [depth]" << endl;
+        exit(-1);
+    }
+    int games = (argc > 2 ? atoi(argv[2]) : 2000);
+    int epochs = (argc > 3 ? atoi(argv[3]) : 20);
+    int depth = (argc > 4 ? atoi(argv[4]) : 2);
+
+    mt19937 rng(2014);
+    vector<Sample> samples = selfPlay(games, depth, rng);
+    shuffle(samples.begin(), samples.end(), rng);
+
+    // Hold out one position in twenty to measure the error on.
+    size_t holdout = samples.size() / 20;
+    vector<Sample> validation(samples.begin(), samples.begin() + holdout);
+    vector<Sample> training(samples.begin() + holdout, samples.end());
+
+    FloatNetwork net(rng);
+    const int batchSize = 256;
+
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        shuffle(training.begin(), training.end(), rng);
+        float rate = 1e-3f * (epoch > epochs * 3 / 4 ? 0.1f : 1.0f);
+        double loss = 0;
+
+        for (size_t start = 0; start < training.size(); start += batchSize) {
+            size_t end = min(training.size(), start + batchSize);
+            for (size_t i = start; i < end; i++) {
+                int sym = rng() % NUM_SYMMETRIES;
+                loss += net.run(transformBoard(training[i].black, sym), transformBoard(training[i].white, sym),
+                                training[i].target, true, 1.0f / (end - start));
+            }
+            net.step(rate);
+        }
+
+        double error = 0;
+        for (Sample &s : validation)
+            error += net.run(s.black, s.white, s.target, false, 0);
+
+        cerr << "epoch " << epoch << ": training mse " << loss / training.size()
+             << ", validation mse " << error / validation.size() << endl;
+    }
+
+    // Check the quantized network against the same positions.
+    Network quantized;
+    net.quantize(quantized);
+    double error = 0;
+    for (Sample &s : validation) {
+        int16_t acc[NN_HIDDEN1];
+        refreshAccumulator(quantized, s.black, s.white, acc);
+        double predicted = evaluateNetwork(quantized, acc) / 6400.0;
+        error += (predicted - s.target) * (predicted - s.target);
+    }
+    cerr << "quantized validation mse " << error / validation.size() << endl;
+
+    if (!saveNetwork(quantized, argv[1])) {
+        cerr << "cannot write " << argv[1] << endl;
+        return 1;
+    }
+    return 0;
+}
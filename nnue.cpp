@@ -0,0 +1,208 @@
+#include "nnue.h"
+#include <cstring>
+#include <cstdio>
+#include <vector>
+
+const Network *activeNetwork = nullptr;
+
+/*
+ * Weight file layout, all little-endian:
+ *
+ *   uint32 magic ("TVNN"), version, inputs, hidden1, hidden2
+ *   int16  w1[inputs][hidden1]
+ *   int16  b1[hidden1]
+ *   int16  w2[hidden2][hidden1]
+ *   int32  b2[hidden2]
+ *   int16  w3[hidden2]
+ *   int32  b3
+ *   uint32 FNV-1a checksum of everything above
+ */
+
+#define HEADER_WORDS 5
+
+inline uint32_t checksum(const char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (uint8_t) data[i]) * 16777619u;
+    return hash;
+}
+
+size_t networkFileSize() {
+    return HEADER_WORDS * sizeof(uint32_t)
+         + sizeof(Network::w1) + sizeof(Network::b1) + sizeof(Network::w2)
+         + sizeof(Network::b2) + sizeof(Network::w3) + sizeof(Network::b3)
+         + sizeof(uint32_t);
+}
+
+void Network::computeFlipRows() {
+    for (int square = 0; square < 64; square++) {
+        for (int i = 0; i < NN_HIDDEN1; i++) {
+            int16_t black = w1[networkFeature(BLACK, square)][i];
+            int16_t white = w1[networkFeature(WHITE, square)][i];
+            flip[BLACK][square][i] = black - white;
+            flip[WHITE][square][i] = white - black;
+        }
+    }
+}
+
+/*
+ * Writes the network in the file format to 'out', which must hold
+ * networkFileSize() bytes, and returns the number of bytes written.
+ */
+size_t serializeNetwork(const Network &net, char *out) {
+    char *p = out;
+    uint32_t header[HEADER_WORDS] = { NN_MAGIC, NN_VERSION, NN_INPUTS, NN_HIDDEN1, NN_HIDDEN2 };
+
+    memcpy(p, header, sizeof(header));    p += sizeof(header);
+    memcpy(p, net.w1, sizeof(net.w1));    p += sizeof(net.w1);
+    memcpy(p, net.b1, sizeof(net.b1));    p += sizeof(net.b1);
+    memcpy(p, net.w2, sizeof(net.w2));    p += sizeof(net.w2);
+    memcpy(p, net.b2, sizeof(net.b2));    p += sizeof(net.b2);
+    memcpy(p, net.w3, sizeof(net.w3));    p += sizeof(net.w3);
+    memcpy(p, &net.b3, sizeof(net.b3));   p += sizeof(net.b3);
+
+    uint32_t sum = checksum(out, p - out);
+    memcpy(p, &sum, sizeof(sum));         p += sizeof(sum);
+    return p - out;
+}
+
+/*
+ * Parses a weight file held in memory. Returns false if it is not a network
+ * of this version and shape, or if the checksum does not match.
+ */
+bool readNetwork(const char *data, size_t size, Network &net) {
+    if (size != networkFileSize())
+        return false;
+
+    uint32_t header[HEADER_WORDS];
+    memcpy(header, data, sizeof(header));
+    if (header[0] != NN_MAGIC || header[1] != NN_VERSION || header[2] != NN_INPUTS ||
+        header[3] != NN_HIDDEN1 || header[4] != NN_HIDDEN2)
+        return false;
+
+    uint32_t sum;
+    memcpy(&sum, data + size - sizeof(sum), sizeof(sum));
+    if (sum != checksum(data, size - sizeof(sum)))
+        return false;
+
+    const char *p = data + sizeof(header);
+    memcpy(net.w1, p, sizeof(net.w1));    p += sizeof(net.w1);
+    memcpy(net.b1, p, sizeof(net.b1));    p += sizeof(net.b1);
+    memcpy(net.w2, p, sizeof(net.w2));    p += sizeof(net.w2);
+    memcpy(net.b2, p, sizeof(net.b2));    p += sizeof(net.b2);
+    memcpy(net.w3, p, sizeof(net.w3));    p += sizeof(net.w3);
+    memcpy(&net.b3, p, sizeof(net.b3));
+
+    net.computeFlipRows();
+    return true;
+}
+
+/*
+ * Loads a weight file and makes it the active evaluator. Must be called
+ * before any search starts.
+ */
+bool loadNetwork(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    std::vector<char> data(networkFileSize() + 1);
+    size_t size = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    Network *net = new Network;
+    if (!readNetwork(data.data(), size, *net)) {
+        delete net;
+        return false;
+    }
+
+    activeNetwork = net;
+    return true;
+}
+
+bool saveNetwork(const Network &net, const char *path) {
+    std::vector<char> data(networkFileSize());
+    size_t size = serializeNetwork(net, data.data());
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(data.data(), 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+/*
+ * Computes the accumulator of a position from scratch.
+ */
+void refreshAccumulator(const Network &net, uint64_t black, uint64_t white, int16_t *acc) {
+    memcpy(acc, net.b1, sizeof(net.b1));
+    for (; black; black &= black - 1)
+        addRow(acc, net.w1[networkFeature(BLACK, __builtin_ctzll(black))]);
+    for (; white; white &= white - 1)
+        addRow(acc, net.w1[networkFeature(WHITE, __builtin_ctzll(white))]);
+}
+
+#ifdef __AVX2__
+inline int32_t horizontalSum(__m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+inline int16_t clipActivation(int32_t x) {
+    return x < 0 ? 0 : x > NN_ACTIVATION_ONE ? NN_ACTIVATION_ONE : x;
+}
+
+/*
+ * Runs layers 2 and 3 on an accumulator. Returns the evaluation for white in
+ * hundredths of a disc.
+ */
+int evaluateNetwork(const Network &net, const int16_t *acc) {
+    alignas(32) int16_t h2[NN_HIDDEN2];
+    int32_t out = net.b3;
+
+#ifdef __AVX2__
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(NN_ACTIVATION_ONE);
+    __m256i h1[NN_HIDDEN1 / 16];
+    for (int i = 0; i < NN_HIDDEN1 / 16; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (acc + 16 * i));
+        h1[i] = _mm256_min_epi16(_mm256_max_epi16(a, zero), one);
+    }
+
+    for (int j = 0; j < NN_HIDDEN2; j++) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < NN_HIDDEN1 / 16; i++) {
+            __m256i w = _mm256_loadu_si256((const __m256i *) (net.w2[j] + 16 * i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(h1[i], w));
+        }
+        h2[j] = clipActivation((net.b2[j] + horizontalSum(sum)) / NN_WEIGHT_ONE);
+    }
+
+    __m256i sum = _mm256_setzero_si256();
+    for (int j = 0; j < NN_HIDDEN2; j += 16) {
+        __m256i h = _mm256_load_si256((const __m256i *) (h2 + j));
+        __m256i w = _mm256_loadu_si256((const __m256i *) (net.w3 + j));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(h, w));
+    }
+    out += horizontalSum(sum);
+#else
+    int16_t h1[NN_HIDDEN1];
+    for (int i = 0; i < NN_HIDDEN1; i++)
+        h1[i] = clipActivation(acc[i]);
+
+    for (int j = 0; j < NN_HIDDEN2; j++) {
+        int32_t sum = net.b2[j];
+        for (int i = 0; i < NN_HIDDEN1; i++)
+            sum += h1[i] * net.w2[j][i];
+        h2[j] = clipActivation(sum / NN_WEIGHT_ONE);
+    }
+
+    for (int j = 0; j < NN_HIDDEN2; j++)
+        out += h2[j] * net.w3[j];
+#endif
+
+    return out * 100 / NN_ACTIVATION_ONE;
+}
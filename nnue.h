@@ -0,0 +1,98 @@
+#ifndef __NNUE_H__
+#define __NNUE_H__
+
+#include "common.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * An optional evaluator: a small quantized neural network whose first layer
+ * is kept up to date incrementally along the search path by Player.
+ *
+ * Input:  128 features, one per (colour, square) with a disc on it.
+ * Layer 1: 128 -> 32, int16 weights. Its output, the accumulator, is the sum
+ *          of the weight rows of the features present. The search keeps one
+ *          per ply, outside Board, so a move only adds the rows of the
+ *          placed disc and the flipped ones to its parent's.
+ * Layer 2: 32 -> 32, int16 weights, clipped ReLU on both sides.
+ * Output:  32 -> 1, the expected final disc differential for white.
+ *
+ * Activations are scaled by NN_ACTIVATION_ONE (127) and the weights of layers
+ * 2 and 3 by NN_WEIGHT_ONE (64). The evaluation is in hundredths of a disc.
+ */
+
+#define NN_INPUTS 128
+#define NN_HIDDEN1 32
+#define NN_HIDDEN2 32
+#define NN_ACTIVATION_ONE 127
+#define NN_WEIGHT_ONE 64
+
+// Weight file header: the magic bytes "TVNN" followed by a version number.
+#define NN_MAGIC 0x4e4e5654u
+#define NN_VERSION 1u
+
+struct Network {
+    int16_t w1[NN_INPUTS][NN_HIDDEN1];
+    int16_t b1[NN_HIDDEN1];
+    int16_t w2[NN_HIDDEN2][NN_HIDDEN1];
+    int32_t b2[NN_HIDDEN2];
+    int16_t w3[NN_HIDDEN2];
+    int32_t b3;
+
+    // Derived when loading: what a disc of the given colour turning over on
+    // a square adds to the accumulator (its row minus the other colour's).
+    int16_t flip[2][64][NN_HIDDEN1];
+
+    void computeFlipRows();
+};
+
+// The network in use, or nullptr when the handwritten evaluation is used.
+extern const Network *activeNetwork;
+
+bool loadNetwork(const char *path);
+bool readNetwork(const char *data, size_t size, Network &net);
+bool saveNetwork(const Network &net, const char *path);
+size_t serializeNetwork(const Network &net, char *out);
+size_t networkFileSize();
+
+inline int networkFeature(Side side, int square) {
+    return (side == BLACK ? 0 : 64) + square;
+}
+
+// Square index of (x, y): the bit it occupies in a bitboard.
+inline int squareIndex(int x, int y) {
+    return 63 - 8 * y - x;
+}
+
+void refreshAccumulator(const Network &net, uint64_t black, uint64_t white, int16_t *acc);
+int evaluateNetwork(const Network &net, const int16_t *acc);
+
+inline void addRow(int16_t *acc, const int16_t *row) {
+#ifdef __AVX2__
+    for (int i = 0; i < NN_HIDDEN1; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (acc + i));
+        __m256i r = _mm256_loadu_si256((const __m256i *) (row + i));
+        _mm256_storeu_si256((__m256i *) (acc + i), _mm256_add_epi16(a, r));
+    }
+#else
+    for (int i = 0; i < NN_HIDDEN1; i++)
+        acc[i] += row[i];
+#endif
+}
+
+/*
+ * Updates the accumulator for side S placing a disc on 'square' and turning
+ * over the discs in 'flipped'.
+ */
+template <Side S>
+inline void updateAccumulator(const Network &net, int16_t *acc, int square, uint64_t flipped) {
+    addRow(acc, net.w1[networkFeature(S, square)]);
+    while (flipped) {
+        addRow(acc, net.flip[S][__builtin_ctzll(flipped)]);
+        flipped &= flipped - 1;
+    }
+}
+
+#endif
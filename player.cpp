@@ -1,31 +1,116 @@
 #include "player.h"
+#include "mcts.h"
+#include "trace.h"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
 // ------------------------------------------------------------ //
 unsigned long currentTimeMillis() {
-    return std::chrono::system_clock::now().time_since_epoch() /
+    return std::chrono::steady_clock::now().time_since_epoch() /
     std::chrono::milliseconds(1);
 }
 
-unsigned long timeUpTime = 0;
-
-void setDuration(long millis) {
+void Player::setDuration(long millis) {
     timeUpTime = currentTimeMillis() + millis;
 }
 
-bool outOfTime() {
+bool Player::outOfTime() {
     return currentTimeMillis() > timeUpTime;
 }
-// ------------------------------------------------------------ //
-unsigned history_table[8][8];
 
-bool cmp(const Move& a, const Move& b) {
-    return history_table[a.x][a.y] > history_table[b.x][b.y];
+/*
+ * Limits every search to 'maxNodes' nodes and/or 'maxDepth' plies of
+ * iterative deepening; 0 means no limit. While either limit is set the
+ * clock is ignored. The search still reads the transposition tables, which
+ * every Player in the process shares and which outlive a search, so it is
+ * only reproducible (the same nodes and move on every run and machine)
+ * when it starts from clearHashTables() and no other search runs in the
+ * process at the same time, as in bench. Games in the server, or a game's
+ * later moves, depend on what was searched before them.
+ */
+void Player::setSearchLimits(uint64_t maxNodes, int maxDepth) {
+    nodeLimit = maxNodes;
+    depthLimit = maxDepth;
+}
+
+/*
+ * Switches getBestMove() to the Monte Carlo tree search, run on 'threads'
+ * threads; 0 switches back to alpha-beta.
+ */
+void Player::useMCTS(int threads) {
+    mctsThreads = threads;
+}
+
+/*
+ * Computes the network accumulator of the root position, and makes room for
+ * one per ply of the deepest iteration. Does nothing without a network.
+ */
+void Player::startAccumulators() {
+    if (!activeNetwork)
+        return;
+    accumulators.resize(maxSearchDepth() + 1);
+    refreshAccumulator(*activeNetwork, board->black, board->white, accumulators[0].data());
+}
+
+/*
+ * Sets the accumulator of 'child', which S reached from 'current' (at
+ * 'depth') with one move or a pass, from that of 'current'.
+ */
+template <Side S>
+inline void Player::playAccumulator(Board *current, Board *child, int depth) {
+    if (!activeNetwork)
+        return;
+    int ply = rootDepth - depth;
+    accumulators[ply + 1] = accumulators[ply];
+
+    uint64_t placed = child->own<S>() & ~(current->own<S>() | current->other<S>());
+    if (placed)
+        updateAccumulator<S>(*activeNetwork, accumulators[ply + 1].data(), __builtin_ctzll(placed),
+                             child->own<S>() & current->other<S>());
+}
+
+/*
+ * Scores a leaf, with the network if there is one, from the accumulator
+ * that playAccumulator() left for its ply.
+ */
+template <Side S>
+inline int Player::evaluateLeaf(Board *current, int depth, int elapsedMoves) {
+    if (!activeNetwork || current->isDone())
+        return current->score<S>(elapsedMoves);
+    int value = evaluateNetwork(*activeNetwork, accumulators[rootDepth - depth].data());
+    return S == WHITE ? value : -value;
+}
+
+/*
+ * Clears the history table and the counters at the start of a search.
+ */
+void Player::resetSearchStats() {
+    for (int i = 0; i < 64; i++)
+        history_table[i / 8][i % 8] = 0;
+    nodes = 0;
+    etcCutoffs = 0;
+    stabilityCutoffs = 0;
+}
+
+/*
+ * Called at every node: throws to abandon the current iteration once the
+ * node budget, or in time mode the clock, has run out.
+ */
+inline void Player::checkLimits(int depth) {
+    nodes++;
+    if (nodeLimit ? nodes > nodeLimit : (!depthLimit && depth == 8 && outOfTime()))
+        throw 1;
 }
 // ------------------------------------------------------------ //
 enum Exactness { LOWER, UPPER, EXACT };
 
+// An all-zero Bucket is an empty one, so the tables can come straight from
+// zeroed pages; 'popularity' starts at 0 for a bucket that was never used.
 struct Bucket {
     int popularity;
     uint64_t white, black;
@@ -34,40 +119,144 @@ struct Bucket {
     Move best_move;
     int value;
     Exactness exactness;
-
-    Bucket() {
-        popularity = -100;
-        white = black = 0ull;
-        depth = 0;
-        best_move = Move(0, 0);
-        value = 0;
-    }
 };
 
-inline int getHash(Board* board) {
+#define TT_SIZE 1000000
+
+// Enhanced transposition cutoffs are only tried this deep; nearer the
+// leaves the probes cost more than the subtrees they could save.
+#define ETC_MIN_DEPTH 3
+
+inline int getHash(uint64_t white, uint64_t black) {
     hash<uint64_t> h;
-    return (h(board->white) + h(board->black)) % 1000000;
+    return (h(white) + h(black)) % TT_SIZE;
+}
+
+inline int getHash(Board* board) {
+    return getHash(board->white, board->black);
 }
 
-Bucket black_hash_table[1000000];
-Bucket white_hash_table[1000000];
+// Set by useHashTableMemory() when the tables live in a shared memory
+// segment (shm.h) instead.
+Bucket* sharedTables = nullptr;
+
+/*
+ * Returns the transposition table of the given side. Both tables are
+ * allocated on first use with calloc(), which hands out untouched zero pages,
+ * so starting the engine costs nothing and only the buckets the search
+ * actually reaches are ever paged in.
+ */
+Bucket* hashTable(Side side) {
+    if (sharedTables)
+        return sharedTables + (side == BLACK ? 0 : TT_SIZE);
+    static Bucket* tables = (Bucket*) calloc(2 * TT_SIZE, sizeof(Bucket));
+    if (!tables) {
+        std::cerr << "cannot allocate the transposition tables ("
+                  << 2 * TT_SIZE * sizeof(Bucket) / (1 << 20) << " MB)" << std::endl;
+        exit(-1);
+    }
+    return tables + (side == BLACK ? 0 : TT_SIZE);
+}
 
-Bucket* try_retrieve(Board* board, Side side) {
-    Bucket* bucket = (side == BLACK ? black_hash_table : white_hash_table) + getHash(board);
+// The tables are shared by every Player in the process, and the server runs
+// several of them at once, so each bucket is guarded by one of a set of
+// striped spinlocks. These are uncontended in the single-game engine. A
+// shared table brings its own locks, which work across processes too.
+#define TT_LOCK_STRIPES 4096
+std::atomic_flag local_tt_locks[TT_LOCK_STRIPES];
+
+/*
+ * Puts every lock in 'locks' in the clear state.
+ */
+static std::atomic_flag* clearLocks(std::atomic_flag* locks) {
+    for (int i = 0; i < TT_LOCK_STRIPES; i++)
+        locks[i].clear();
+    return locks;
+}
+
+std::atomic_flag* tt_locks = clearLocks(local_tt_locks);
+
+/*
+ * Size of a shared memory segment holding the locks and both tables.
+ */
+size_t hashTableBytes() {
+    return TT_LOCK_STRIPES * sizeof(std::atomic_flag) + 2 * TT_SIZE * sizeof(Bucket);
+}
 
-    if (bucket->white == board->white && bucket->black == board->black) {
+/*
+ * Sets up hashTableBytes() of fresh memory for useHashTableMemory(): clear
+ * locks, empty tables.
+ */
+void initHashTableMemory(void* memory) {
+    memset(memory, 0, hashTableBytes());
+    clearLocks((std::atomic_flag*) memory);
+}
+
+/*
+ * Moves the locks and tables to 'memory', hashTableBytes() of zeroed (or
+ * already shared) memory. Must be called before any search.
+ */
+void useHashTableMemory(void* memory) {
+    static_assert(TT_LOCK_STRIPES * sizeof(std::atomic_flag) % alignof(Bucket) == 0,
+                  "the tables must be aligned after the locks");
+    tt_locks = (std::atomic_flag*) memory;
+    sharedTables = (Bucket*) (tt_locks + TT_LOCK_STRIPES);
+}
+
+struct BucketLock {
+    std::atomic_flag& flag;
+    BucketLock(int hash) : flag(tt_locks[hash % TT_LOCK_STRIPES]) {
+        while (flag.test_and_set(std::memory_order_acquire))
+            ;
+    }
+    ~BucketLock() { flag.clear(std::memory_order_release); }
+};
+
+/*
+ * Copies out the entry for a position about to be searched, and counts the
+ * hit or miss in the bucket's popularity. Returns false on a miss.
+ */
+bool try_retrieve(Board* board, Side side, Bucket& entry) {
+    int hash = getHash(board);
+    BucketLock lock(hash);
+    Bucket& bucket = hashTable(side)[hash];
+
+    if (bucket.white == board->white && bucket.black == board->black) {
         //hit++;
-        bucket->popularity++;
-        return bucket;
+        bucket.popularity++;
+        entry = bucket;
+        return true;
     } else {
         //miss++;
-        bucket->popularity--;
-        return nullptr;
+        bucket.popularity--;
+        return false;
     }
 }
 
+/*
+ * Copies out the entry for a position without touching the bucket, for
+ * probes that may not lead to a search of the position. Returns false if
+ * the table holds a different position there.
+ */
+bool probe(uint64_t white, uint64_t black, Side side, Bucket& entry) {
+    int hash = getHash(white, black);
+    BucketLock lock(hash);
+    entry = hashTable(side)[hash];
+    return entry.white == white && entry.black == black;
+}
+
+/*
+ * Empties both tables, so that a search does not depend on what was searched
+ * before it.
+ */
+void clearHashTables() {
+    memset(hashTable(BLACK), 0, 2 * TT_SIZE * sizeof(Bucket));
+}
+
 void try_save(Board* board, int score, Move move, int alpha, int beta, int depth, Side side) {
-    Bucket& bucket = (side == BLACK ? black_hash_table : white_hash_table)[getHash(board)];
+    int hash = getHash(board);
+    BucketLock lock(hash);
+    Bucket& bucket = hashTable(side)[hash];
     Exactness flag;
 
     if (score <= alpha) {
@@ -97,7 +286,7 @@ void try_save(Board* board, int score, Move move, int alpha, int beta, int depth
         }
     }
 
-    if (bucket.popularity > -100)
+    if (bucket.popularity > 0)
         return;
 
     //bo++;
@@ -108,7 +297,7 @@ void try_save(Board* board, int score, Move move, int alpha, int beta, int depth
     bucket.value = score;
     bucket.best_move = move;
     bucket.depth = depth;
-    bucket.popularity = 500;
+    bucket.popularity = 600;
 }
 // ------------------------------------------------------------ //
 
@@ -129,6 +318,18 @@ Player::Player(Side s) {
     opponentSide = (OPPOSITE(s));
     elapsed_moves = 0;
     finalMode = false;
+    timeUpTime = 0;
+    nodes = 0;
+    nodeLimit = 0;
+    depthLimit = 0;
+    mctsThreads = 0;
+    mcts = nullptr;
+    rootDepth = 0;
+    useETC = true;
+    useStabilityCutoff = true;
+    etcCutoffs = stabilityCutoffs = 0;
+    traceSearch = 0;
+    traceIndex = traceBest = -1;
 }
 
 /*
@@ -136,6 +337,7 @@ Player::Player(Side s) {
  */
 Player::~Player() {
     delete board;
+    delete mcts;
 }
 
 /*
@@ -188,15 +390,31 @@ Move Player::getBestMove()
     if (!finalMode && (elapsed_moves >= 44 || board->countBlack() + board->countWhite() >= 44))
         finalMode = true;
 
-    for (int i = 0; i < 64; i++)
-        history_table[i / 8][i % 8] = 0;
+    if (mctsThreads) {
+        if (!mcts)
+            mcts = new MCTS();
+        // Like alpha-beta, ignore the clock while a limit is set: a depth
+        // limit alone becomes a playout budget.
+        uint64_t maxPlayouts = (nodeLimit || !depthLimit ? nodeLimit
+                                : (uint64_t) depthLimit * MCTS_PLAYOUTS_PER_PLY);
+        Move move = mcts->search(*board, ourSide, mctsThreads, timeUpTime, maxPlayouts);
+        nodes = mcts->playouts;
+        return move;
+    }
+
+    resetSearchStats();
+    startAccumulators();
 
     Move bestMove(-1, -1);
-    for (int i = 1; i < 20; i++) {
+    for (int i = 1; i <= maxSearchDepth(); i++) {
         for (int j = 0; j < 64; j++)
             history_table[j / 8][j % 8] /= 2;
 
         //yeayeah cerr << "PLY IS " << i << ": ";
+        rootDepth = i;
+        traceIndex = -1;
+        if (traceEnabled)
+            traceSearch = newTraceSearch();
         try {
             Move move(-1, -1);
             int minim = negamax(board, ourSide, i, -(INT_MAX - 1), INT_MAX - 1, elapsed_moves, move);
@@ -211,58 +429,240 @@ Move Player::getBestMove()
     return bestMove;
 }
 
+/*
+ * Multi-PV search: returns the best 'k' legal moves, best first, with their
+ * scores. Every iteration of the deepening searches the first k moves with a
+ * full window; each remaining move only gets a null-window search against
+ * the k-th best score so far, plus a re-search if it beats it. The moves
+ * that never make the top k keep an upper bound instead of an exact score.
+ * Iterative deepening, move ordering and the transposition table are shared
+ * by all k lines.
+ *
+ * Returns fewer than k moves if there are fewer legal ones, and none if k is
+ * less than 1. If the limits stop the first iteration, only the moves it
+ * got to are returned, so every move comes with a score that was searched.
+ */
+vector<RankedMove> Player::getBestMoves(int k)
+{
+    if (k < 1)
+        return {};
+
+    if (!finalMode && (elapsed_moves >= 44 || board->countBlack() + board->countWhite() >= 44))
+        finalMode = true;
+
+    resetSearchStats();
+    startAccumulators();
+
+    vector<RankedMove> ranked;
+    for (Move &move : board->getMoves(ourSide))
+        ranked.push_back({ move, 0, false });
+    sort(ranked.begin(), ranked.end(), [this](const RankedMove& a, const RankedMove& b) {
+        return history_table[a.move.x][a.move.y] > history_table[b.move.x][b.move.y];
+    });
+    k = min(k, (int) ranked.size());
+
+    // Exact scores first, best first; the order also seeds the next
+    // iteration's move ordering.
+    auto byScore = [](const RankedMove& a, const RankedMove& b) {
+        if (a.exact != b.exact)
+            return a.exact;
+        return a.score > b.score;
+    };
+
+    for (int i = 1; i <= maxSearchDepth() && !ranked.empty(); i++) {
+        for (int j = 0; j < 64; j++)
+            history_table[j / 8][j % 8] /= 2;
+
+        vector<RankedMove> iteration;
+        // Exact scores found so far in this iteration, best first.
+        vector<int> best;
+
+        // The root itself is not searched by negamax, so its children are
+        // the tops of the recorded trees.
+        rootDepth = i;
+        if (traceEnabled)
+            traceSearch = newTraceSearch();
+
+        try {
+            for (RankedMove &line : ranked) {
+                Board copy(*board);
+                copy.doMove(&line.move, ourSide);
+                if (ourSide == BLACK)
+                    playAccumulator<BLACK>(board, &copy, i);
+                else
+                    playAccumulator<WHITE>(board, &copy, i);
+                Move dummy(-1, -1);
+                traceIndex = &line - &ranked[0];
+
+                RankedMove result = { line.move, 0, true };
+                if ((int) best.size() < k) {
+                    result.score = -negamax(&copy, opponentSide, i - 1, -(INT_MAX - 1), INT_MAX - 1,
+                                            elapsed_moves + 1, dummy);
+                } else {
+                    int threshold = best[k - 1];
+                    int score = -negamax(&copy, opponentSide, i - 1, -threshold - 1, -threshold,
+                                         elapsed_moves + 1, dummy);
+                    if (score > threshold) {
+                        result.score = -negamax(&copy, opponentSide, i - 1, -(INT_MAX - 1), -threshold,
+                                                elapsed_moves + 1, dummy);
+                    } else {
+                        result.score = threshold;
+                        result.exact = false;
+                    }
+                }
+
+                if (result.exact)
+                    best.insert(upper_bound(best.begin(), best.end(), result.score, greater<int>()),
+                                result.score);
+                iteration.push_back(result);
+            }
+        } catch(...) {
+            // The moves not reached in the first iteration have no score
+            // at all; later iterations fall back on the last complete one.
+            if (i == 1) {
+                stable_sort(iteration.begin(), iteration.end(), byScore);
+                ranked = iteration;
+            }
+            break;
+        }
+
+        stable_sort(iteration.begin(), iteration.end(), byScore);
+        ranked = iteration;
+    }
+
+    if ((int) ranked.size() > k)
+        ranked.resize(k);
+    return ranked;
+}
+
 /*
  * Calculates highest-scoring move using a negamax algorithm to arbitrary depth.
+ * The search is specialised on the side to move, alternating between the
+ * two instantiations; this just picks the first one.
  */
- ////// MODIFIED FOR NEGASCOUT //////
 int Player::negamax(Board *current, Side player, int depth, int a, int b,
-                    int elapsedMoves, Move &ret /*pseudo-return-value.*/)
+                    int elapsedMoves, Move &ret)
+{
+    return player == BLACK ? negamax<BLACK>(current, depth, a, b, elapsedMoves, ret)
+                           : negamax<WHITE>(current, depth, a, b, elapsedMoves, ret);
+}
+
+template <Side S>
+inline int Player::negamax(Board *current, int depth, int a, int b,
+                           int elapsedMoves, Move &ret)
+{
+    if (traceEnabled)
+        return negamaxTraced<S>(current, depth, a, b, elapsedMoves, ret);
+    return negamaxNode<S>(current, depth, a, b, elapsedMoves, ret);
+}
+
+/*
+ * negamax() with the search tree recorder on: searches the node, then
+ * records it once its subtree is done. Leaves are not recorded, and neither
+ * are nodes abandoned by checkLimits().
+ */
+template <Side S>
+int Player::negamaxTraced(Board *current, int depth, int a, int b,
+                          int elapsedMoves, Move &ret)
+{
+    uint64_t before = nodes;
+    int index = traceIndex;
+    int result = negamaxNode<S>(current, depth, a, b, elapsedMoves, ret);
+
+    if (depth > 0 && !current->isDone()) {
+        TraceRecord record;
+        record.hash = traceHash(current->black, current->white, S);
+        record.alpha = a;
+        record.beta = b;
+        record.result = result;
+        record.nodes = (uint32_t) min<uint64_t>(nodes - before, UINT32_MAX);
+        record.search = traceSearch;
+        record.ply = rootDepth - depth;
+        record.depth = depth;
+        record.index = index;
+        record.best = traceBest;
+        traceNode(record);
+    }
+    return result;
+}
+
+ ////// MODIFIED FOR NEGASCOUT //////
+template <Side S>
+int Player::negamaxNode(Board *current, int depth, int a, int b,
+                        int elapsedMoves, Move &ret /*pseudo-return-value.*/)
 {
     //it++;
     int old_alpha = a;
 
-    if (depth == 8 && outOfTime())
-        throw 1;
+    checkLimits(depth);
 
     if (depth == 0 || current->isDone()) {
-        return current->score(player, elapsedMoves);
+        return evaluateLeaf<S>(current, depth, elapsedMoves);
     }
 
-    Bucket* bucket = nullptr;
+    // Stability cutoff. Every ply fills a square or passes, and two passes
+    // in a row end the game, so with 'depth' at least twice the empty
+    // squares every leaf below is a finished game, scored INT_MAX - 1 for a
+    // win and -(INT_MAX - 1) otherwise. Stable discs cannot change hands, so
+    // more than 32 of them decide which it will be. Exactly 32 do not: a
+    // 32-32 finish counts as a loss for whichever side is to move at the
+    // end (Board::score), which depends on the line. Not at the root, which
+    // has to come up with a move.
+    if (useStabilityCutoff && depth < rootDepth &&
+        depth >= 2 * (64 - popcount(current->black | current->white))) {
+        if (popcount(current->other<S>() & current->stablesOf<OPPOSITE(S)>()) > 32) {
+            stabilityCutoffs++;
+            traceBest = -1;
+            return -(INT_MAX - 1);
+        }
+        if (popcount(current->own<S>() & current->stablesOf<S>()) > 32) {
+            stabilityCutoffs++;
+            traceBest = -1;
+            return INT_MAX - 1;
+        }
+    }
+
+    Bucket bucket;
+    bool hit = false;
 
-    //bucket = try_retrieve(current, player);
-    bucket = nullptr;
+    //hit = try_retrieve(current, S, bucket);
 
-    if (bucket != nullptr && bucket->depth >= depth) {
-        if (bucket->exactness == EXACT) {
-            ret = bucket->best_move;
+    if (hit && bucket.depth >= depth) {
+        if (bucket.exactness == EXACT) {
+            ret = bucket.best_move;
             //si++;
-            return bucket->value;
-        } else if (bucket->exactness == LOWER) {
-            if (bucket->value > a)
-                a = bucket->value;
-        } else if (bucket->exactness == UPPER) {
-            if (bucket->value < b)
-                b = bucket->value;
+            return bucket.value;
+        } else if (bucket.exactness == LOWER) {
+            if (bucket.value > a)
+                a = bucket.value;
+        } else if (bucket.exactness == UPPER) {
+            if (bucket.value < b)
+                b = bucket.value;
         }
 
         if (a >= b) {
             //si++;
-            ret = bucket->best_move;
-            return bucket->value;
+            ret = bucket.best_move;
+            return bucket.value;
         }
     }
 
     Move dummy(-1, -1);
 
-    if (!current->hasMoves(player))
-        return -negamax(current, OPPOSITE(player), depth - 1, -b, -a,
+    if (!current->hasMoves<S>()) {
+        traceIndex = 0;
+        playAccumulator<S>(current, current, depth);
+        int score = -negamax<OPPOSITE(S)>(current, depth - 1, -b, -a,
                 elapsedMoves + 1, dummy);
+        traceBest = -1;
+        return score;
+    }
 
-    if (bucket != nullptr) {
-        Move& move = bucket->best_move;
-        Board *copy = current->copyDoMove(&move, player);
-        int score = -negamax(copy, OPPOSITE(player), depth - 1, -b, -a,
+    if (hit) {
+        Move& move = bucket.best_move;
+        Board *copy = current->copyDoMove<S>(&move);
+        playAccumulator<S>(current, copy, depth);
+        int score = -negamax<OPPOSITE(S)>(copy, depth - 1, -b, -a,
                              elapsedMoves + 1, dummy);
 
         delete copy;
@@ -282,13 +682,45 @@ int Player::negamax(Board *current, Side player, int depth, int a, int b,
         }
     }
 
-    vector<Move> moves = current->getMoves(player);
-    sort(moves.begin(), moves.end(), cmp);
+    vector<Move> moves = current->getMoves<S>();
+    sort(moves.begin(), moves.end(), [this](const Move& a, const Move& b) {
+        return history_table[a.x][a.y] > history_table[b.x][b.y];
+    });
+
+    // Enhanced transposition cutoff: before searching any child, look for
+    // one whose table entry, deep enough and at most its true value, already
+    // proves a cutoff here.
+    if (useETC && depth >= ETC_MIN_DEPTH) {
+        uint64_t own = current->own<S>(), other = current->other<S>();
+        for (size_t i = 0; i < moves.size(); i++) {
+            uint64_t flipped = Board::flips(moves[i].x, moves[i].y, own, other);
+            uint64_t childOwn = own | flipped | getSinglePosition(moves[i].x, moves[i].y);
+            uint64_t childOther = other & ~flipped;
+
+            Bucket entry;
+            if (!probe(S == WHITE ? childOwn : childOther, S == WHITE ? childOther : childOwn,
+                       OPPOSITE(S), entry))
+                continue;
+            if (entry.depth >= depth - 1 && entry.exactness != LOWER && -entry.value >= b) {
+                etcCutoffs++;
+                ret = moves[i];
+                traceBest = i;
+                return -entry.value;
+            }
+        }
+    }
 
+    // At the last ply every child is a leaf, so score them all in one batch.
+    if (depth == 1)
+        return negamaxFrontier<S>(current, a, b, elapsedMoves, moves, ret);
+
+    int bestIndex = -1;
     if (moves.size() > 0) {
         Move& move = moves[0];
-        Board *copy = current->copyDoMove(&move, player);
-        int score = -negamax(copy, OPPOSITE(player), depth - 1, -b, -a,
+        Board *copy = current->copyDoMove<S>(&move);
+        playAccumulator<S>(current, copy, depth);
+        traceIndex = 0;
+        int score = -negamax<OPPOSITE(S)>(copy, depth - 1, -b, -a,
                              elapsedMoves + 1, dummy);
 
         delete copy;
@@ -296,10 +728,12 @@ int Player::negamax(Board *current, Side player, int depth, int a, int b,
         if (score >= a) {
             ret = move;
             a = score;
+            bestIndex = 0;
         }
 
         if (a >= b) { // no longer worth pursuing branch
-            try_save(current, a, ret, old_alpha, b, depth, player);
+            traceBest = bestIndex;
+            try_save(current, a, ret, old_alpha, b, depth, S);
 
             if (ret.x != -1 && ret.y != -1)
                 history_table[ret.x][ret.y] += pow(2, depth);
@@ -310,13 +744,16 @@ int Player::negamax(Board *current, Side player, int depth, int a, int b,
 
     for (auto iter = moves.begin() + 1; iter != moves.end(); iter++) {
         Move& move = *iter;
-        Board *copy = current->copyDoMove(&move, player);
-        int score = -negamax(copy, OPPOSITE(player), depth - 1, -a-1, -a,
+        Board *copy = current->copyDoMove<S>(&move);
+        playAccumulator<S>(current, copy, depth);
+        traceIndex = iter - moves.begin();
+        int score = -negamax<OPPOSITE(S)>(copy, depth - 1, -a-1, -a,
                              elapsedMoves + 1, dummy);
 
         if (a < score && score < b) {
             //ft++;
-            score = -negamax(copy, OPPOSITE(player), depth - 1, -b, -score,
+            traceIndex = iter - moves.begin();
+            score = -negamax<OPPOSITE(S)>(copy, depth - 1, -b, -score,
                              elapsedMoves + 1, dummy);
         }
         delete copy;
@@ -324,6 +761,7 @@ int Player::negamax(Board *current, Side player, int depth, int a, int b,
         if (score > a) {
             ret = move;
             a = score;
+            bestIndex = iter - moves.begin();
         }
 
         if (a >= b) // no longer worth pursuing branch
@@ -333,6 +771,57 @@ int Player::negamax(Board *current, Side player, int depth, int a, int b,
     if (ret.x != -1 && ret.y != -1)
         history_table[ret.x][ret.y] += pow(2, depth);
 
-    try_save(current, a, ret, old_alpha, b, depth, player);
+    traceBest = bestIndex;
+    try_save(current, a, ret, old_alpha, b, depth, S);
+    return a;
+}
+
+/*
+ * The last ply of negamax(): evaluates every child of 'current' with one
+ * call to scoreBatch() instead of a recursive call per child, then picks the
+ * best move exactly as negamax() would have.
+ */
+template <Side S>
+int Player::negamaxFrontier(Board *current, int a, int b,
+                            int elapsedMoves, vector<Move> &moves, Move &ret)
+{
+    int old_alpha = a;
+    BoardBatch batch;
+    int scores[BoardBatch::CAPACITY];
+
+    nodes += moves.size();
+    for (Move &move : moves) {
+        Board child(*current);
+        child.doMove<S>(&move);
+        if (activeNetwork) {
+            playAccumulator<S>(current, &child, 1);
+            scores[batch.size] = evaluateLeaf<OPPOSITE(S)>(&child, 0, elapsedMoves + 1);
+        }
+        batch.add(child);
+    }
+
+    // The network evaluator works from each child's accumulator instead.
+    if (!activeNetwork)
+        scoreBatch<OPPOSITE(S)>(batch, elapsedMoves + 1, scores);
+
+    traceBest = -1;
+    for (int i = 0; i < batch.size; i++) {
+        int score = -scores[i];
+
+        // The first move takes ties, like the full-window search does.
+        if (score > a || (i == 0 && score == a)) {
+            ret = moves[i];
+            a = score;
+            traceBest = i;
+        }
+
+        if (a >= b) // no longer worth pursuing branch
+            break;
+    }
+
+    if (ret.x != -1 && ret.y != -1)
+        history_table[ret.x][ret.y] += 2;
+
+    try_save(current, a, ret, old_alpha, b, 1, S);
     return a;
 }
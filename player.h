@@ -4,9 +4,30 @@
 #include <iostream>
 #include "common.h"
 #include "board.h"
+#include "nnue.h"
+#include <array>
 #include <unordered_map>
+#include <vector>
 using namespace std;
 
+class MCTS;
+
+// Milliseconds on a monotonic clock, the unit of the search deadlines.
+unsigned long currentTimeMillis();
+
+// Empties the transposition tables shared by every Player. A search with
+// limits (Player::setSearchLimits()) that starts from empty tables, with no
+// other search running, is reproducible.
+void clearHashTables();
+
+// A root move with its score. When 'exact' is false, 'score' is only an upper
+// bound on the move's value.
+struct RankedMove {
+    Move move;
+    int score;
+    bool exact;
+};
+
 class Player {
 public:
     Player(Side s);
@@ -14,8 +35,30 @@ public:
 
     Move *doMove(Move *opponentsMove, int msLeft);
     Move getBestMove();
+    vector<RankedMove> getBestMoves(int k);
+    void setDuration(long millis);
+    bool outOfTime();
+    void setSearchLimits(uint64_t maxNodes, int maxDepth);
+    void useMCTS(int threads);
+    void resetSearchStats();
+    void checkLimits(int depth);
+    int maxSearchDepth() { return depthLimit ? depthLimit : 19; }
     //int naiveMinimax(Board* current, Side side, int depth, bool max, Move& bestMove, int elapsedMoves);
     int negamax(Board *current, Side player, int depth, int a, int b, int elapsed_moves, Move &ret);
+    template <Side S>
+    int negamax(Board *current, int depth, int a, int b, int elapsedMoves, Move &ret);
+    template <Side S>
+    int negamaxNode(Board *current, int depth, int a, int b, int elapsedMoves, Move &ret);
+    template <Side S>
+    int negamaxTraced(Board *current, int depth, int a, int b, int elapsedMoves, Move &ret);
+    template <Side S>
+    int negamaxFrontier(Board *current, int a, int b, int elapsedMoves,
+                        vector<Move> &moves, Move &ret);
+    void startAccumulators();
+    template <Side S>
+    void playAccumulator(Board *current, Board *child, int depth);
+    template <Side S>
+    int evaluateLeaf(Board *current, int depth, int elapsedMoves);
 
     // Flag to tell if the player is running within the test_minimax context
     bool testingMinimax;
@@ -25,6 +68,44 @@ public:
     Side ourSide, opponentSide;
     int elapsed_moves;
     bool finalMode;
+
+    // Move-ordering history and search deadline, kept per player so that
+    // several games can be searched at once in one process.
+    unsigned history_table[8][8];
+    unsigned long timeUpTime;
+
+    // Nodes visited by the last search, and the limits set with
+    // setSearchLimits().
+    uint64_t nodes;
+    uint64_t nodeLimit;
+    int depthLimit;
+
+    // Threads for the Monte Carlo search (mcts.h), or 0 for alpha-beta. In
+    // MCTS mode 'nodes' and 'nodeLimit' count playouts, and a depth limit
+    // alone allows MCTS_PLAYOUTS_PER_PLY playouts per ply.
+    int mctsThreads;
+    MCTS *mcts;
+
+    // Depth of the current iteration of the deepening.
+    int rootDepth;
+
+    // Interior-node pruning, both on by default: enhanced transposition
+    // cutoffs, and cutoffs from the stable discs once the search reaches
+    // the end of the game. The counters are per search, like 'nodes'.
+    bool useETC, useStabilityCutoff;
+    uint64_t etcCutoffs, stabilityCutoffs;
+
+    // Search tree recorder state (trace.h): the id of the current iteration,
+    // the move order index of the node being entered, and the index of the
+    // best move of the node just finished.
+    uint32_t traceSearch;
+    int traceIndex, traceBest;
+
+    // First-layer outputs of the network evaluator (nnue.h) for the
+    // positions on the current search path, by ply (rootDepth - depth).
+    // Empty unless a network is in use, so that Boards stay small for the
+    // handwritten evaluation.
+    vector<array<int16_t, NN_HIDDEN1>> accumulators;
 };
 
 #endif
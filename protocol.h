@@ -0,0 +1,91 @@
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+
+/*
+ * Binary protocol spoken between TVMAServer and its clients over a Unix
+ * domain socket. Every message is a fixed-size frame in host byte order
+ * (both ends are on the same host). One connection can carry any number of
+ * games; a client must wait for the response to a request before sending the
+ * next request for the same game.
+ */
+
+#define DEFAULT_SOCKET_PATH "/tmp/tvma.sock"
+#define SOCKET_ENV_VAR "TVMA_SOCKET"
+
+enum RequestType : uint8_t {
+    // Start a game. 'side' is the side the engine plays; 'game' is ignored.
+    // The response carries the new game's id.
+    REQ_NEW_GAME = 1,
+    // The opponent played (x, y), or passed if x < 0. The response carries
+    // the engine's move, or (-1, -1) for a pass.
+    REQ_MOVE = 2,
+    // Forget a game. Answered with RESP_OK.
+    REQ_END_GAME = 3
+};
+
+enum ResponseStatus : uint8_t {
+    RESP_OK = 0,
+    RESP_ERROR = 1
+};
+
+struct Request {
+    uint8_t type;
+    uint8_t side;   // BLACK or WHITE, for REQ_NEW_GAME
+    int8_t x, y;    // opponent's move, for REQ_MOVE
+    int32_t msLeft; // time left in the game, for REQ_MOVE; -1 for no limit
+    uint32_t game;
+};
+
+struct Response {
+    uint8_t status;
+    int8_t x, y;
+    uint8_t unused;
+    uint32_t game;
+};
+
+static_assert(sizeof(Request) == 12, "Request frame must be 12 bytes");
+static_assert(sizeof(Response) == 8, "Response frame must be 8 bytes");
+
+/*
+ * Reads or writes exactly 'size' bytes, retrying on short transfers.
+ * Returns false on error or end of file.
+ */
+inline bool readFrame(int fd, void *data, size_t size) {
+    char *p = (char *) data;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+inline bool writeFrame(int fd, const void *data, size_t size) {
+    const char *p = (const char *) data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+inline const char *socketPath() {
+    const char *path = getenv(SOCKET_ENV_VAR);
+    return path ? path : DEFAULT_SOCKET_PATH;
+}
+
+#endif
@@ -0,0 +1,237 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "player.h"
+#include "protocol.h"
+using namespace std;
+
+/*
+ * A long-lived engine that plays many games at once. Clients connect over a
+ * Unix domain socket and speak the binary protocol in protocol.h; every game
+ * has its own Player, while the worker threads and the transposition table
+ * are shared by all of them.
+ */
+
+struct Connection {
+    int fd;
+    mutex writeLock;
+
+    Connection(int fd) : fd(fd) {}
+    ~Connection() { close(fd); }
+
+    bool send(const Response &response) {
+        lock_guard<mutex> lock(writeLock);
+        return writeFrame(fd, &response, sizeof(response));
+    }
+};
+
+struct Game {
+    uint32_t id;
+    Player *player;
+    shared_ptr<Connection> connection;
+
+    Game(uint32_t id, Side side, shared_ptr<Connection> connection)
+        : id(id), player(new Player(side)), connection(connection) {}
+    ~Game() { delete player; }
+};
+
+struct Job {
+    shared_ptr<Game> game;
+    Move opponentsMove;
+    int msLeft;
+    chrono::steady_clock::time_point queued;
+};
+
+/*
+ * Runs the moves of all games on a fixed pool of threads.
+ *
+ * Requests are served oldest first, so no game can starve another. The time
+ * a request spends waiting in the queue is taken off that game's clock, and
+ * when more games are thinking than there are workers, every game's clock is
+ * scaled down to its fair share of the workers, so that a busy server makes
+ * all of its games think proportionally less rather than letting the last
+ * ones in the queue lose on time.
+ */
+class Scheduler {
+public:
+    Scheduler(int workers) : workers(workers), active(0) {
+        for (int i = 0; i < workers; i++)
+            threads.emplace_back(&Scheduler::run, this);
+    }
+
+    void submit(Job job) {
+        lock_guard<mutex> lock(queueLock);
+        queue.push_back(job);
+        ready.notify_one();
+    }
+
+private:
+    void run() {
+        while (true) {
+            Job job;
+            int competing;
+            {
+                unique_lock<mutex> lock(queueLock);
+                ready.wait(lock, [this] { return !queue.empty(); });
+                job = queue.front();
+                queue.pop_front();
+                active++;
+                competing = active + queue.size();
+            }
+
+            int msLeft = job.msLeft;
+            if (msLeft > 0) {
+                long waited = chrono::duration_cast<chrono::milliseconds>(
+                    chrono::steady_clock::now() - job.queued).count();
+                msLeft = max(1L, msLeft - waited);
+                if (competing > workers)
+                    msLeft = max(1L, (long) msLeft * workers / competing);
+            }
+
+            Move *opponentsMove = (job.opponentsMove.x >= 0 ? &job.opponentsMove : nullptr);
+            Move *move = job.game->player->doMove(opponentsMove, msLeft);
+
+            Response response = { RESP_OK, -1, -1, 0, job.game->id };
+            if (move != nullptr) {
+                response.x = move->x;
+                response.y = move->y;
+                delete move;
+            }
+            job.game->connection->send(response);
+
+            lock_guard<mutex> lock(queueLock);
+            active--;
+        }
+    }
+
+    int workers;
+    int active;
+    deque<Job> queue;
+    mutex queueLock;
+    condition_variable ready;
+    vector<thread> threads;
+};
+
+Scheduler *scheduler;
+
+unordered_map<uint32_t, shared_ptr<Game>> games;
+mutex gamesLock;
+uint32_t nextGameId = 1;
+
+/*
+ * Reads requests from one client until it disconnects. Moves are handed to
+ * the scheduler, which answers them when they are done; everything else is
+ * answered right away.
+ */
+void serveConnection(int fd) {
+    shared_ptr<Connection> connection = make_shared<Connection>(fd);
+    vector<uint32_t> owned;
+    Request request;
+
+    while (readFrame(fd, &request, sizeof(request))) {
+        Response response = { RESP_ERROR, -1, -1, 0, request.game };
+        shared_ptr<Game> game;
+
+        switch (request.type) {
+        case REQ_NEW_GAME: {
+            lock_guard<mutex> lock(gamesLock);
+            uint32_t id = nextGameId++;
+            Side side = (request.side == BLACK ? BLACK : WHITE);
+            games[id] = make_shared<Game>(id, side, connection);
+            owned.push_back(id);
+            response.status = RESP_OK;
+            response.game = id;
+            break;
+        }
+        case REQ_MOVE: {
+            {
+                lock_guard<mutex> lock(gamesLock);
+                auto it = games.find(request.game);
+                if (it != games.end() && it->second->connection == connection)
+                    game = it->second;
+            }
+            if (game) {
+                scheduler->submit({ game, Move(request.x, request.y), request.msLeft,
+                                    chrono::steady_clock::now() });
+                continue;
+            }
+            break;
+        }
+        case REQ_END_GAME: {
+            lock_guard<mutex> lock(gamesLock);
+            auto it = games.find(request.game);
+            if (it != games.end() && it->second->connection == connection) {
+                games.erase(it);
+                response.status = RESP_OK;
+            }
+            break;
+        }
+        }
+
+        if (!connection->send(response))
+            break;
+    }
+
+    // Games still running when the client goes away are dropped; a move that
+    // is being searched keeps its game alive until it finishes.
+    lock_guard<mutex> lock(gamesLock);
+    for (uint32_t id : owned)
+        games.erase(id);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 3) {
+        cerr << "usage: " << argv[0] << " [socket-path] [threads]" << endl;
+        exit(-1);
+    }
+    const char *path = (argc > 1 ? argv[1] : socketPath());
+    int threads = (argc > 2 ? atoi(argv[2]) : (int) thread::hardware_concurrency());
+    if (threads < 1)
+        threads = 1;
+
+    // A client that disconnects mid-reply must not kill the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        cerr << "socket path too long: " << path << endl;
+        exit(-1);
+    }
+    strcpy(address.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (listener < 0 || bind(listener, (sockaddr *) &address, sizeof(address)) < 0 ||
+        listen(listener, 64) < 0) {
+        cerr << "cannot listen on " << path << ": " << strerror(errno) << endl;
+        exit(-1);
+    }
+
+    scheduler = new Scheduler(threads);
+    cerr << "Listening on " << path << " with " << threads << " threads" << endl;
+
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            cerr << "accept failed: " << strerror(errno) << endl;
+            break;
+        }
+        thread(serveConnection, fd).detach();
+    }
+
+    return 0;
+}
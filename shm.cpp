@@ -0,0 +1,132 @@
+#include "shm.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Defined in player.cpp.
+size_t hashTableBytes();
+void initHashTableMemory(void *memory);
+void useHashTableMemory(void *memory);
+
+static uint32_t checksum(const char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (uint8_t) data[i]) * 16777619u;
+    return hash;
+}
+
+/*
+ * Creates the segment 'name' with the given payload, or set up by 'init' if
+ * 'payload' is null. An existing segment of that name is replaced;
+ * processes attached to it keep their mapping of the old one.
+ */
+static bool publishSegment(const char *name, SharedKind kind, uint32_t payloadVersion,
+                           const void *payload, size_t size, void (*init)(void *) = nullptr) {
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+
+    size_t total = sizeof(SharedHeader) + size;
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, total) == 0)
+        base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        return false;
+    }
+
+    SharedHeader *header = (SharedHeader *) base;
+    char *data = (char *) (header + 1);
+    if (payload)
+        memcpy(data, payload, size);
+    else if (init)
+        init(data);
+
+    header->version = SHM_VERSION;
+    header->kind = kind;
+    header->payloadVersion = payloadVersion;
+    header->payloadSize = size;
+    header->checksum = (payload ? checksum(data, size) : 0);
+    __atomic_store_n(&header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+    munmap(base, total);
+    return true;
+}
+
+/*
+ * Maps the segment 'name' and checks its header (and, if 'verify', its
+ * checksum). Returns its payload, or nullptr.
+ */
+static void *attachSegment(const char *name, SharedKind kind, uint32_t payloadVersion,
+                           size_t size, bool writable, bool verify) {
+    int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    size_t total = sizeof(SharedHeader) + size;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size == total)
+        base = mmap(nullptr, total, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return nullptr;
+
+    const SharedHeader *header = (const SharedHeader *) base;
+    char *data = (char *) base + sizeof(SharedHeader);
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+        header->version != SHM_VERSION || header->kind != kind ||
+        header->payloadVersion != payloadVersion || header->payloadSize != size ||
+        (verify && header->checksum != checksum(data, size))) {
+        munmap(base, total);
+        return nullptr;
+    }
+    return data;
+}
+
+bool publishNetwork(const char *name, const Network &net) {
+    return publishSegment(name, SHARED_NETWORK, NN_VERSION, &net, sizeof(Network));
+}
+
+/*
+ * Makes the network published as 'name' the active evaluator. Like
+ * loadNetwork(), this must come before any search starts.
+ */
+bool attachNetwork(const char *name) {
+    void *net = attachSegment(name, SHARED_NETWORK, NN_VERSION, sizeof(Network), false, true);
+    if (!net)
+        return false;
+    activeNetwork = (const Network *) net;
+    return true;
+}
+
+/*
+ * Creates an empty shared transposition table for processes working on the
+ * same analysis. A process that dies while holding one of its bucket locks
+ * leaves that stripe locked for the others, so this is for cooperating
+ * processes on one job, not for independent games.
+ */
+bool createSharedHashTable(const char *name) {
+    return publishSegment(name, SHARED_HASH_TABLE, 0, nullptr, hashTableBytes(),
+                          initHashTableMemory);
+}
+
+/*
+ * Makes every Player in this process use the shared table 'name' instead of
+ * its own. Must come before the first search.
+ */
+bool attachSharedHashTable(const char *name) {
+    void *memory = attachSegment(name, SHARED_HASH_TABLE, 0, hashTableBytes(), true, false);
+    if (!memory)
+        return false;
+    useHashTableMemory(memory);
+    return true;
+}
+
+bool removeSegment(const char *name) {
+    return shm_unlink(name) == 0;
+}
@@ -0,0 +1,54 @@
+#ifndef __SHM_H__
+#define __SHM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "nnue.h"
+
+/*
+ * Engine data shared between processes through named POSIX shared memory
+ * segments, so that many engines on one host map one copy instead of each
+ * building its own. shmload publishes the segments; TVMA attaches to them
+ * with --shm and --shared-tt.
+ *
+ * Every segment starts with a SharedHeader. 'magic' is written last, once
+ * the payload and its checksum are in place, so a segment that is still
+ * being published is never attached; any mismatch in the header (another
+ * version, kind or payload size, e.g. from a different build) or in the
+ * checksum makes attaching fail.
+ *
+ * The lookup tables of constants.h need no segment: they are constexpr, so
+ * they are part of the binary's read-only data, which the kernel already
+ * shares between all the processes running it.
+ */
+
+#define SHM_MAGIC 0x48535654u // "TVSH"
+#define SHM_VERSION 1u
+
+#define DEFAULT_NETWORK_SEGMENT "/tvma-network"
+#define DEFAULT_HASH_SEGMENT "/tvma-hash"
+
+enum SharedKind : uint32_t {
+    // A Network, with its flip rows already derived; read-only.
+    SHARED_NETWORK = 1,
+    // The transposition tables and their locks, written by every process
+    // attached to it. Not checksummed.
+    SHARED_HASH_TABLE = 2
+};
+
+struct alignas(64) SharedHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t kind;
+    uint32_t payloadVersion; // NN_VERSION for a network
+    uint64_t payloadSize;
+    uint32_t checksum;       // FNV-1a of the payload
+};
+
+bool publishNetwork(const char *name, const Network &net);
+bool attachNetwork(const char *name);
+bool createSharedHashTable(const char *name);
+bool attachSharedHashTable(const char *name);
+bool removeSegment(const char *name);
+
+#endif
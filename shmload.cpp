@@ -0,0 +1,68 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include "shm.h"
+using namespace std;
+
+/*
+ * Publishes engine data into shared memory for TVMA --shm and --shared-tt
+ * (see shm.h).
+ *
+ *   shmload network weights.bin [name]
+ *       Loads and checks a weight file from nntrain and publishes the
+ *       network as 'name' (default /tvma-network).
+ *
+ *   shmload hash [name]
+ *       Creates an empty shared transposition table (default /tvma-hash).
+ *
+ *   shmload remove name
+ *       Removes a segment. Processes attached to it keep their mapping.
+ */
+
+void usage(const char *name) {
+    cerr << "usage: " << name << " network weights.bin [name]\n"
+         << "       " << name << " hash [name]\n"
+         << "       " << name << " remove name" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        usage(argv[0]);
+
+    if (!strcmp(argv[1], "network") && (argc == 3 || argc == 4)) {
+        const char *name = (argc == 4 ? argv[3] : DEFAULT_NETWORK_SEGMENT);
+        if (!loadNetwork(argv[2])) {
+            cerr << "cannot load network weights from " << argv[2] << endl;
+            return 1;
+        }
+        if (!publishNetwork(name, *activeNetwork)) {
+            cerr << "cannot publish " << name << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        cout << "published " << argv[2] << " as " << name << endl;
+        return 0;
+    }
+
+    if (!strcmp(argv[1], "hash") && (argc == 2 || argc == 3)) {
+        const char *name = (argc == 3 ? argv[2] : DEFAULT_HASH_SEGMENT);
+        if (!createSharedHashTable(name)) {
+            cerr << "cannot create " << name << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        cout << "created " << name << endl;
+        return 0;
+    }
+
+    if (!strcmp(argv[1], "remove") && argc == 3) {
+        if (!removeSegment(argv[2])) {
+            cerr << "cannot remove " << argv[2] << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    usage(argv[0]);
+    return -1;
+}
@@ -0,0 +1,144 @@
+#ifndef __SYMMETRY_H__
+#define __SYMMETRY_H__
+
+#include "common.h"
+
+/*
+ * The eight symmetries (the dihedral group) of the board, applied to raw
+ * bitboards. Square (x, y) lives at bit 63 - (8 * y + x), so row 0 is the
+ * most significant byte and column 0 the most significant bit of each byte.
+ *
+ * A symmetry is numbered 0-7. Bit 2 means "transpose (swap x and y)", bit 0
+ * means "mirror x" and bit 1 means "mirror y", applied in that order, so
+ * symmetry 0 is the identity.
+ */
+enum Symmetry {
+    SYM_IDENTITY = 0,
+    SYM_FLIP_HORIZONTAL = 1, // (x, y) -> (7 - x, y)
+    SYM_FLIP_VERTICAL = 2,   // (x, y) -> (x, 7 - y)
+    SYM_ROTATE_180 = 3,      // (x, y) -> (7 - x, 7 - y)
+    SYM_FLIP_DIAGONAL = 4,   // (x, y) -> (y, x)
+    SYM_ROTATE_90 = 5,       // (x, y) -> (7 - y, x), clockwise
+    SYM_ROTATE_270 = 6,      // (x, y) -> (y, 7 - x)
+    SYM_FLIP_ANTI_DIAGONAL = 7 // (x, y) -> (7 - y, 7 - x)
+};
+
+#define NUM_SYMMETRIES 8
+
+/* Mirrors the board top-to-bottom: row y becomes row 7 - y. */
+inline uint64_t flipVertical(uint64_t b) {
+    return __builtin_bswap64(b);
+}
+
+/* Mirrors the board left-to-right: column x becomes column 7 - x. */
+inline uint64_t flipHorizontal(uint64_t b) {
+    b = ((b >> 1) & 0x5555555555555555ull) | ((b & 0x5555555555555555ull) << 1);
+    b = ((b >> 2) & 0x3333333333333333ull) | ((b & 0x3333333333333333ull) << 2);
+    b = ((b >> 4) & 0x0f0f0f0f0f0f0f0full) | ((b & 0x0f0f0f0f0f0f0f0full) << 4);
+    return b;
+}
+
+/*
+ * Transposes the board about the (0, 0)-(7, 7) diagonal with three delta
+ * swaps: 4x4 blocks, then 2x2 blocks, then single squares.
+ */
+inline uint64_t flipDiagonal(uint64_t b) {
+    uint64_t t;
+    t = 0x0f0f0f0f00000000ull & (b ^ (b << 28)); b ^= t ^ (t >> 28);
+    t = 0x3333000033330000ull & (b ^ (b << 14)); b ^= t ^ (t >> 14);
+    t = 0x5500550055005500ull & (b ^ (b << 7));  b ^= t ^ (t >> 7);
+    return b;
+}
+
+/* Transposes the board about the (7, 0)-(0, 7) diagonal. */
+inline uint64_t flipAntiDiagonal(uint64_t b) {
+    uint64_t t;
+    t = b ^ (b << 36);
+    b ^= 0xf0f0f0f00f0f0f0full & (t ^ (b >> 36));
+    t = 0xcccc0000cccc0000ull & (b ^ (b << 18)); b ^= t ^ (t >> 18);
+    t = 0xaa00aa00aa00aa00ull & (b ^ (b << 9));  b ^= t ^ (t >> 9);
+    return b;
+}
+
+/* Rotates the board a quarter turn clockwise. */
+inline uint64_t rotate90(uint64_t b) { return flipHorizontal(flipDiagonal(b)); }
+inline uint64_t rotate180(uint64_t b) { return flipHorizontal(flipVertical(b)); }
+inline uint64_t rotate270(uint64_t b) { return flipVertical(flipDiagonal(b)); }
+
+/*
+ * Applies symmetry 'sym' to a bitboard.
+ */
+inline uint64_t transformBoard(uint64_t b, int sym) {
+    switch (sym) {
+    case SYM_FLIP_HORIZONTAL:    return flipHorizontal(b);
+    case SYM_FLIP_VERTICAL:      return flipVertical(b);
+    case SYM_ROTATE_180:         return rotate180(b);
+    case SYM_FLIP_DIAGONAL:      return flipDiagonal(b);
+    case SYM_ROTATE_90:          return rotate90(b);
+    case SYM_ROTATE_270:         return rotate270(b);
+    case SYM_FLIP_ANTI_DIAGONAL: return flipAntiDiagonal(b);
+    default:                     return b;
+    }
+}
+
+/*
+ * Maps a move on the original board to the same move on the board
+ * transformed by 'sym'. A pass (-1, -1) is left alone.
+ */
+inline Move transformMove(Move m, int sym) {
+    if (m.x < 0 || m.y < 0)
+        return m;
+
+    int x = m.x, y = m.y;
+    if (sym & 4) { int t = x; x = y; y = t; }
+    if (sym & 1) x = 7 - x;
+    if (sym & 2) y = 7 - y;
+    return Move(x, y);
+}
+
+/*
+ * The inverse of transformMove(): maps a move found on the board transformed
+ * by 'sym' back onto the original board.
+ */
+inline Move untransformMove(Move m, int sym) {
+    if (m.x < 0 || m.y < 0)
+        return m;
+
+    int x = m.x, y = m.y;
+    if (sym & 2) y = 7 - y;
+    if (sym & 1) x = 7 - x;
+    if (sym & 4) { int t = x; x = y; y = t; }
+    return Move(x, y);
+}
+
+/*
+ * Replaces (black, white) with its canonical form: the lexicographically
+ * smallest (black, white) pair over all eight symmetries. Positions that are
+ * symmetric to each other share a canonical form, so a table keyed by it
+ * stores them once. Returns the symmetry that was applied; use
+ * untransformMove() with it to map a stored move back onto the real board.
+ */
+inline int canonicalize(uint64_t &black, uint64_t &white) {
+    uint64_t b[NUM_SYMMETRIES], w[NUM_SYMMETRIES];
+
+    b[0] = black;               w[0] = white;
+    b[1] = flipHorizontal(b[0]); w[1] = flipHorizontal(w[0]);
+    b[2] = flipVertical(b[0]);   w[2] = flipVertical(w[0]);
+    b[3] = flipVertical(b[1]);   w[3] = flipVertical(w[1]);
+    b[4] = flipDiagonal(b[0]);   w[4] = flipDiagonal(w[0]);
+    b[5] = flipHorizontal(b[4]); w[5] = flipHorizontal(w[4]);
+    b[6] = flipVertical(b[4]);   w[6] = flipVertical(w[4]);
+    b[7] = flipVertical(b[5]);   w[7] = flipVertical(w[5]);
+
+    int best = 0;
+    for (int i = 1; i < NUM_SYMMETRIES; i++) {
+        if (b[i] < b[best] || (b[i] == b[best] && w[i] < w[best]))
+            best = i;
+    }
+
+    black = b[best];
+    white = w[best];
+    return best;
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+bool traceEnabled = false;
+
+#define TRACE_RING_SIZE (1 << 16)
+
+/*
+ * A single-producer, single-consumer ring: the owning thread advances
+ * 'head', the flusher advances 'tail'.
+ */
+struct TraceRing {
+    TraceRecord records[TRACE_RING_SIZE];
+    std::atomic<uint64_t> head, tail;
+    std::atomic<bool> inUse;
+};
+
+// Every ring ever handed out. A thread gives its ring back when it exits,
+// and the next new thread takes it over once the flusher has emptied it.
+static std::vector<TraceRing *> rings;
+static std::mutex ringsLock;
+
+static FILE *traceFile;
+static std::thread flusher;
+static std::atomic<bool> flusherStop;
+static std::atomic<uint32_t> nextSearch;
+
+static TraceRing *acquireRing() {
+    std::lock_guard<std::mutex> lock(ringsLock);
+    for (TraceRing *ring : rings) {
+        bool free = false;
+        if (ring->inUse.compare_exchange_strong(free, true))
+            return ring;
+    }
+
+    TraceRing *ring = new TraceRing;
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->inUse.store(true);
+    rings.push_back(ring);
+    return ring;
+}
+
+struct RingHandle {
+    TraceRing *ring = nullptr;
+    ~RingHandle() {
+        if (ring)
+            ring->inUse.store(false, std::memory_order_release);
+    }
+};
+
+static thread_local RingHandle handle;
+
+void traceNode(const TraceRecord &record) {
+    if (!handle.ring)
+        handle.ring = acquireRing();
+    TraceRing *ring = handle.ring;
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    while (head - ring->tail.load(std::memory_order_acquire) >= TRACE_RING_SIZE)
+        std::this_thread::yield();
+
+    ring->records[head % TRACE_RING_SIZE] = record;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint32_t newTraceSearch() {
+    return nextSearch.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Writes out whatever the rings hold. Returns false if they were all empty.
+ */
+static bool drain() {
+    std::vector<TraceRing *> current;
+    {
+        std::lock_guard<std::mutex> lock(ringsLock);
+        current = rings;
+    }
+
+    bool wrote = false;
+    for (TraceRing *ring : current) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        while (tail < head) {
+            uint64_t start = tail % TRACE_RING_SIZE;
+            uint64_t count = head - tail;
+            if (count > TRACE_RING_SIZE - start)
+                count = TRACE_RING_SIZE - start;
+            fwrite(ring->records + start, sizeof(TraceRecord), count, traceFile);
+            tail += count;
+            wrote = true;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+
+    if (wrote)
+        fflush(traceFile);
+    return wrote;
+}
+
+static void flushLoop() {
+    while (!flusherStop.load(std::memory_order_relaxed)) {
+        if (!drain())
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    drain();
+}
+
+/*
+ * Starts recording every search in this process to 'path'. Returns false
+ * if the file cannot be written, or if a trace is already being recorded.
+ */
+bool startTrace(const char *path) {
+    if (flusher.joinable())
+        return false;
+
+    traceFile = fopen(path, "wb");
+    if (!traceFile)
+        return false;
+
+    TraceHeader header = { TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord), 0 };
+    fwrite(&header, sizeof(header), 1, traceFile);
+
+    flusherStop.store(false);
+    flusher = std::thread(flushLoop);
+    traceEnabled = true;
+    return true;
+}
+
+/*
+ * Stops recording, and writes out the records still in the rings.
+ */
+void stopTrace() {
+    if (!traceEnabled)
+        return;
+    traceEnabled = false;
+
+    flusherStop.store(true);
+    flusher.join();
+    fclose(traceFile);
+    traceFile = nullptr;
+}
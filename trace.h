@@ -0,0 +1,63 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <cstdint>
+
+/*
+ * Search tree recorder. While tracing is on, Player::negamax writes one
+ * record per interior node it finishes (leaves are only counted, in their
+ * parent's 'nodes'), so the records of a search come out in post-order:
+ * every node after all of its children. treeprof rebuilds the trees from
+ * them.
+ *
+ * Each thread writes into its own ring buffer, which a background thread
+ * drains into the trace file; a thread only waits if its ring is full.
+ * When tracing is off, all that is left in the search is a test of
+ * 'traceEnabled' per node.
+ *
+ * File layout: a TraceHeader, then TraceRecords until the end of the file.
+ * The records of one search are in order; those of searches run at the
+ * same time on different threads are interleaved.
+ */
+
+#define TRACE_MAGIC 0x52545654u // "TVTR"
+#define TRACE_VERSION 1u
+
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t unused;
+};
+
+struct TraceRecord {
+    uint64_t hash;        // position and side to move, see traceHash()
+    int32_t alpha, beta;  // window on entry
+    int32_t result;
+    uint32_t nodes;       // nodes searched in the subtree, this one included
+    uint32_t search;      // one id per iteration of a search
+    uint8_t ply, depth;
+    int8_t index;         // place in the parent's move order, or -1
+    int8_t best;          // index of the best move found, or -1 if none
+};
+
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must be 32 bytes");
+
+// Set by startTrace() and stopTrace(); only change it while no search runs.
+extern bool traceEnabled;
+
+bool startTrace(const char *path);
+void stopTrace();
+void traceNode(const TraceRecord &record);
+
+// A fresh id for TraceRecord::search.
+uint32_t newTraceSearch();
+
+inline uint64_t traceHash(uint64_t black, uint64_t white, int side) {
+    uint64_t h = (black * 0x9e3779b97f4a7c15ull) ^ (white * 0xc2b2ae3d27d4eb4full) ^ side;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    return h ^ (h >> 32);
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include "trace.h"
+using namespace std;
+
+/*
+ * Rebuilds the search trees recorded with TVMA --trace or bench search and
+ * reports where the work went.
+ *
+ *   treeprof trace.bin [top]
+ *
+ * Prints, for the 'top' (default 10) worst nodes of each kind:
+ *   - per depth, how often the first move was the best one at cutoffs;
+ *   - the subtrees that blew up most compared to others of the same depth;
+ *   - the worst ordered nodes: those that spent the most nodes on the moves
+ *     searched before their best one;
+ *   - the positions searched again under a different parent, at the same
+ *     depth in the same iteration: what a transposition table hit would
+ *     have saved.
+ */
+
+struct TraceNode {
+    TraceRecord r;
+    int parent;
+    vector<int> children;
+};
+
+vector<TraceNode> nodes;
+
+bool readTrace(const char *path) {
+    ifstream in(path, ios::binary);
+    TraceHeader header;
+    if (!in.read((char *) &header, sizeof(header)) || header.magic != TRACE_MAGIC ||
+        header.version != TRACE_VERSION || header.recordSize != sizeof(TraceRecord))
+        return false;
+
+    TraceRecord r;
+    while (in.read((char *) &r, sizeof(r)))
+        nodes.push_back({ r, -1, {} });
+    return true;
+}
+
+/*
+ * Records come in post-order, so a node's children are the nodes one ply
+ * deeper that were finished since the last node at its own ply or above.
+ * Returns the tops of the trees.
+ */
+vector<int> buildTrees() {
+    map<uint32_t, vector<int>> stacks;
+    for (int i = 0; i < (int) nodes.size(); i++) {
+        vector<int> &stack = stacks[nodes[i].r.search];
+        while (!stack.empty() && nodes[stack.back()].r.ply > nodes[i].r.ply) {
+            nodes[stack.back()].parent = i;
+            nodes[i].children.push_back(stack.back());
+            stack.pop_back();
+        }
+        reverse(nodes[i].children.begin(), nodes[i].children.end());
+        stack.push_back(i);
+    }
+
+    vector<int> tops;
+    for (auto &search : stacks)
+        tops.insert(tops.end(), search.second.begin(), search.second.end());
+    return tops;
+}
+
+void printHeading(const char *title) {
+    cout << "\n# " << title << "\n"
+         << "# search\tply\tdepth\talpha\tbeta\tresult\tbest\tnodes\thash" << endl;
+}
+
+void printNode(const TraceNode &node) {
+    const TraceRecord &r = node.r;
+    cout << r.search << "\t" << (int) r.ply << "\t" << (int) r.depth << "\t"
+         << r.alpha << "\t" << r.beta << "\t" << r.result << "\t" << (int) r.best << "\t"
+         << r.nodes << "\t" << hex << r.hash << dec;
+}
+
+/*
+ * Prints the 'top' nodes with the highest 'key', with the key as an extra
+ * column.
+ */
+template <typename Key>
+void printTop(const char *title, const char *column, size_t top, Key key) {
+    vector<pair<double, int>> ranked;
+    for (int i = 0; i < (int) nodes.size(); i++) {
+        double k = key(i);
+        if (k > 0)
+            ranked.push_back({ k, i });
+    }
+    sort(ranked.begin(), ranked.end(), greater<pair<double, int>>());
+    if (ranked.size() > top)
+        ranked.resize(top);
+
+    printHeading(title);
+    cout << "# (last column: " << column << ")" << endl;
+    for (auto &entry : ranked) {
+        printNode(nodes[entry.second]);
+        cout << "\t" << entry.first << "\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        cerr << "usage: " << argv[0] << " trace.bin [top]" << endl;
+        return -1;
+    }
+    size_t top = (argc > 2 ? atoi(argv[2]) : 10);
+
+    if (!readTrace(argv[1])) {
+        cerr << "cannot read a trace from " << argv[1] << endl;
+        return 1;
+    }
+    vector<int> tops = buildTrees();
+
+    uint64_t total = 0;
+    for (int i : tops)
+        total += nodes[i].r.nodes;
+    cout << nodes.size() << " interior nodes recorded, " << tops.size() << " trees, "
+         << total << " nodes searched" << endl;
+
+    // Move ordering by depth.
+    struct DepthStats { uint64_t count = 0, nodes = 0, cutoffs = 0, firstCutoffs = 0; };
+    map<int, DepthStats> depths;
+    for (TraceNode &node : nodes) {
+        DepthStats &d = depths[node.r.depth];
+        d.count++;
+        d.nodes += node.r.nodes;
+        if (node.r.result >= node.r.beta) {
+            d.cutoffs++;
+            d.firstCutoffs += (node.r.best == 0);
+        }
+    }
+    cout << "\n# depth\tnodes recorded\tmean subtree\tcutoffs\tfirst move cutoffs" << endl;
+    for (auto &entry : depths) {
+        DepthStats &d = entry.second;
+        cout << entry.first << "\t" << d.count << "\t" << (double) d.nodes / d.count << "\t"
+             << d.cutoffs << "\t" << fixed << setprecision(1)
+             << (d.cutoffs ? 100.0 * d.firstCutoffs / d.cutoffs : 0) << "%"
+             << defaultfloat << setprecision(6) << "\n";
+    }
+
+    printTop("Biggest subtrees for their depth", "nodes / mean at that depth", top, [&](int i) {
+        const TraceRecord &r = nodes[i].r;
+        if (nodes[i].parent < 0)
+            return 0.0;
+        DepthStats &d = depths[r.depth];
+        return r.nodes * (double) d.count / d.nodes;
+    });
+
+    printTop("Worst ordered nodes", "nodes spent before the best move", top, [&](int i) {
+        uint64_t wasted = 0;
+        for (int child : nodes[i].children) {
+            if (nodes[child].r.index < nodes[i].r.best)
+                wasted += nodes[child].r.nodes;
+        }
+        return (double) wasted;
+    });
+
+    // Transpositions: the same position and depth reached from more than one
+    // parent in one iteration. Re-searches of a child by the same parent are
+    // not counted.
+    map<pair<uint32_t, pair<uint64_t, int>>, vector<int>> positions;
+    for (int i = 0; i < (int) nodes.size(); i++)
+        positions[{ nodes[i].r.search, { nodes[i].r.hash, nodes[i].r.depth } }].push_back(i);
+
+    // A search counts once, at the top of a repeated subtree, not again for
+    // every node inside it. Parents come after their children, so going
+    // backwards visits them first.
+    vector<int> firstParent(nodes.size());
+    for (auto &entry : positions)
+        for (int i : entry.second)
+            firstParent[i] = nodes[entry.second[0]].parent;
+
+    vector<bool> inRepeat(nodes.size(), false);
+    vector<double> repeated(nodes.size(), 0);
+    uint64_t repeatedTotal = 0;
+    for (int i = (int) nodes.size() - 1; i >= 0; i--) {
+        int parent = nodes[i].parent;
+        bool inside = (parent >= 0 && inRepeat[parent]);
+        inRepeat[i] = inside || parent != firstParent[i];
+        if (inRepeat[i] && !inside) {
+            int first = positions[{ nodes[i].r.search, { nodes[i].r.hash, nodes[i].r.depth } }][0];
+            repeated[first] += nodes[i].r.nodes;
+            repeatedTotal += nodes[i].r.nodes;
+        }
+    }
+    cout << "\n" << repeatedTotal << " nodes spent on transpositions ("
+         << fixed << setprecision(1) << (total ? 100.0 * repeatedTotal / total : 0) << "%)"
+         << defaultfloat << setprecision(6) << endl;
+    printTop("Most searched transpositions", "nodes spent under other parents", top,
+             [&](int i) { return repeated[i]; });
+
+    return 0;
+}
@@ -1,19 +1,65 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <cctype>
+#include <thread>
 #include "player.h"
+#include "trace.h"
+#include "shm.h"
 using namespace std;
 
+void usage(const char *name) {
+    cerr << "usage: " << name << " side [--nnue weights | --shm [name]] [--shared-tt [name]]\n"
+         << "           [--mcts [threads]] [--trace file]" << endl;
+    exit(-1);
+}
+
 int main(int argc, char *argv[]) {
-    // Read in side the player is on.
-    if (argc != 2)  {
-        cerr << "usage: " << argv[0] << " side" << endl;
-        exit(-1);
-    }
+    // Read in side the player is on, and the options: the network
+    // evaluator, from a file or a shared memory segment, a shared
+    // transposition table, the Monte Carlo search with its number of
+    // threads, and the search tree recorder.
+    if (argc < 2)
+        usage(argv[0]);
     Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
 
+    int mctsThreads = 0;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--nnue") && i + 1 < argc) {
+            if (!loadNetwork(argv[++i])) {
+                cerr << "cannot load network weights from " << argv[i] << endl;
+                exit(-1);
+            }
+        } else if (!strcmp(argv[i], "--shm")) {
+            const char *name = (i + 1 < argc && argv[i + 1][0] == '/' ? argv[++i] : DEFAULT_NETWORK_SEGMENT);
+            if (!attachNetwork(name)) {
+                cerr << "cannot attach to the network in " << name << endl;
+                exit(-1);
+            }
+        } else if (!strcmp(argv[i], "--shared-tt")) {
+            const char *name = (i + 1 < argc && argv[i + 1][0] == '/' ? argv[++i] : DEFAULT_HASH_SEGMENT);
+            if (!attachSharedHashTable(name)) {
+                cerr << "cannot attach to the transposition table in " << name << endl;
+                exit(-1);
+            }
+        } else if (!strcmp(argv[i], "--mcts")) {
+            mctsThreads = (i + 1 < argc && isdigit(argv[i + 1][0]) ? atoi(argv[++i])
+                                                                   : thread::hardware_concurrency());
+            if (mctsThreads < 1)
+                mctsThreads = 1;
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            if (!startTrace(argv[++i])) {
+                cerr << "cannot write " << argv[i] << endl;
+                exit(-1);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+
     // Initialize player.
     Player *player = new Player(side);
+    player->useMCTS(mctsThreads);
 
     // Tell java wrapper that we are done initializing.
     cout << "Init done" << endl;
@@ -43,5 +89,6 @@ int main(int argc, char *argv[]) {
         if (playersMove != NULL) delete playersMove;
     }
 
+    stopTrace();
     return 0;
 }